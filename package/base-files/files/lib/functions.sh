@@ -321,10 +321,15 @@ ipcalc() {
 }
 
 find_mtd_index() {
-	local PART="$(grep "\"$1\"" /proc/mtd | awk -F: '{print $1}')"
-	local INDEX="${PART##mtd}"
-
-	echo ${INDEX}
+	local dev size erasesize name
+
+	# parsed in the shell, this is called for every MAC address lookup
+	while read dev size erasesize name; do
+		[ "$name" = "\"$1\"" ] || continue
+		dev="${dev%:}"
+		echo ${dev##mtd}
+		break
+	done < /proc/mtd
 }
 
 find_mtd_part() {
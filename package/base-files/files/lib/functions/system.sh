@@ -12,7 +12,19 @@ get_mac_binary() {
 		return
 	fi
 
-	hexdump -v -n 6 -s $offset -e '5/1 "%02x:" 1/1 "%02x"' $path 2>/dev/null
+	# Board detection often reads the same address several times, e.g.
+	# for the label MAC and as base for the interface MACs. Character
+	# devices such as /dev/urandom must never be cached.
+	if [ -n "$BOARD_DETECT_CACHE" ] && [ -b "$path" -o -f "$path" ]; then
+		local cache="$BOARD_DETECT_CACHE/binary${path//\//_}@$((offset))"
+		local macaddr
+
+		[ -f "$cache" ] || hexdump -v -n 6 -s $offset -e '5/1 "%02x:" 1/1 "%02x"' $path > "$cache" 2>/dev/null
+		read -r macaddr < "$cache"
+		echo -n $macaddr
+	else
+		hexdump -v -n 6 -s $offset -e '5/1 "%02x:" 1/1 "%02x"' $path 2>/dev/null
+	fi
 }
 
 get_mac_label_dt() {
@@ -73,7 +85,16 @@ mtd_get_mac_ascii() {
 		return
 	fi
 
-	mac_dirty=$(strings "$part" | sed -n 's/^'"$key"'=//p')
+	# During board detection the strings of a partition are extracted
+	# only once and shared by all lookups, see /bin/board_detect
+	if [ -n "$BOARD_DETECT_CACHE" ]; then
+		local cache="$BOARD_DETECT_CACHE/strings${part//\//_}"
+
+		[ -f "$cache" ] || strings "$part" | grep = > "$cache"
+		mac_dirty=$(sed -n 's/^'"$key"'=//p' "$cache")
+	else
+		mac_dirty=$(strings "$part" | sed -n 's/^'"$key"'=//p')
+	fi
 
 	# "canonicalize" mac
 	[ -n "$mac_dirty" ] && macaddr_canonicalize "$mac_dirty"
@@ -44,6 +44,8 @@ struct ltq_atm_ops {
 };
 
 #include <linux/atomic.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
 #include <lantiq_atm.h>
 
 /*
@@ -201,12 +203,25 @@ struct connection {
 	unsigned int aal5_vcc_crc_err; /* number of packets with CRC error */
 	unsigned int aal5_vcc_oversize_sdu; /* number of packets with oversize error */
 
+	struct sk_buff_head rx_queue; /* received packets waiting for vcc->push */
+	unsigned int rx_pdu;          /* packets pushed to the upper layer */
+	unsigned int rx_backlog_drop; /* packets dropped because rx_queue was full */
+	u64 rx_delay_total;           /* time spent in rx_queue by pushed packets, in us */
+	unsigned int rx_delay_max;    /* longest time spent in rx_queue, in us */
+
+	unsigned int tx_inflight;     /* bytes handed to the PPE, not yet completed */
+	u64 tx_completed;             /* bytes completed by the PPE */
+
 	unsigned int port;
 };
 
 struct atm_priv_data {
 	unsigned long conn_table;
 	struct connection conn[MAX_PVC_NUMBER];
+	unsigned int rx_next_conn;   /*  next connection to push to, round-robin */
+
+	struct net_device napi_dev;
+	struct napi_struct napi;
 
 	volatile struct rx_descriptor *aal_desc;
 	unsigned int aal_desc_pos;
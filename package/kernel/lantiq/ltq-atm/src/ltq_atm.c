@@ -108,6 +108,10 @@ static int dma_tx_descriptor_length = 64;       /*  Number of descriptors per DM
   \brief PPE core clock cycles between descriptor write and effectiveness in external RAM
  */
 static int dma_rx_clp1_descriptor_threshold = 38;
+/*!
+  \brief Number of received packets queued per VCC before dropping
+ */
+static int rx_vcc_backlog = 32;                 /*  Received packets queued per VCC                 */
 /*@}*/
 
 MODULE_PARM(qsb_tau, "i");
@@ -139,6 +143,8 @@ MODULE_PARM(dma_tx_descriptor_length, "i");
 MODULE_PARM_DESC(dma_tx_descriptor_length, "Number of descriptor assigned to DMA TX channel (>16)");
 MODULE_PARM(dma_rx_clp1_descriptor_threshold, "i");
 MODULE_PARM_DESC(dma_rx_clp1_descriptor_threshold, "Descriptor threshold for cells with cell loss priority 1");
+MODULE_PARM(rx_vcc_backlog, "i");
+MODULE_PARM_DESC(rx_vcc_backlog, "Number of received packets queued per VCC before dropping (>0)");
 
 
 
@@ -172,6 +178,7 @@ static void ppe_close(struct atm_vcc *);
 static int ppe_send(struct atm_vcc *, struct sk_buff *);
 static int ppe_send_oam(struct atm_vcc *, void *, int);
 static int ppe_change_qos(struct atm_vcc *, struct atm_qos *, int);
+static int ppe_proc_read(struct atm_dev *, loff_t *, char *);
 
 /*
  *  ADSL LED
@@ -196,15 +203,10 @@ static inline int get_tx_desc(unsigned int);
  *  mailbox handler and signal function
  */
 static inline void mailbox_oam_rx_handler(void);
-static inline void mailbox_aal_rx_handler(void);
+static inline void mailbox_aal_rx_handler(int);
 static irqreturn_t mailbox_irq_handler(int, void *);
 static inline void mailbox_signal(unsigned int, int);
-static void do_ppe_tasklet(unsigned long);
-#if LINUX_VERSION_CODE < KERNEL_VERSION(5,9,0)
-DECLARE_TASKLET(g_dma_tasklet, do_ppe_tasklet, 0);
-#else
-DECLARE_TASKLET_OLD(g_dma_tasklet, do_ppe_tasklet);
-#endif
+static int ppe_poll(struct napi_struct *, int);
 
 /*
  *  QSB & HTU setting functions
@@ -274,6 +276,7 @@ static struct atmdev_ops g_ifx_atm_ops = {
 	.send = ppe_send,
 	.send_oam = ppe_send_oam,
 	.change_qos = ppe_change_qos,
+	.proc_read = ppe_proc_read,
 	.owner = THIS_MODULE,
 };
 
@@ -458,6 +461,7 @@ static void ppe_close(struct atm_vcc *vcc)
 	int conn;
 	struct port *port;
 	struct connection *connection;
+	struct sk_buff *skb;
 	if ( vcc == NULL )
 		return;
 
@@ -501,7 +505,19 @@ static void ppe_close(struct atm_vcc *vcc)
 	}
 
 	/* wait for incoming packets to be processed by upper layers */
-	tasklet_unlock_wait(&g_dma_tasklet);
+	napi_synchronize(&g_atm_priv_data.napi);
+
+	/* drop what was received but not pushed yet */
+	while ( (skb = skb_dequeue(&connection->rx_queue)) != NULL ) {
+		atm_return(vcc, skb->truesize);
+		dev_kfree_skb_any(skb);
+	}
+	connection->rx_pdu = 0;
+	connection->rx_backlog_drop = 0;
+	connection->rx_delay_total = 0;
+	connection->rx_delay_max = 0;
+	/* tx_inflight stays, the ring may still hold skbs of this vcc */
+	connection->tx_completed = 0;
 
 PPE_CLOSE_EXIT:
 	return;
@@ -596,9 +612,13 @@ static int ppe_send(struct atm_vcc *vcc, struct sk_buff *skb)
 		goto PPE_SEND_FAIL;
 	}
 	/*  update descriptor send pointer  */
-	if ( g_atm_priv_data.conn[conn].tx_skb[desc_base] != NULL )
+	if ( g_atm_priv_data.conn[conn].tx_skb[desc_base] != NULL ) {
+		g_atm_priv_data.conn[conn].tx_inflight -= g_atm_priv_data.conn[conn].tx_skb[desc_base]->len;
+		g_atm_priv_data.conn[conn].tx_completed += g_atm_priv_data.conn[conn].tx_skb[desc_base]->len;
 		dev_kfree_skb_any(g_atm_priv_data.conn[conn].tx_skb[desc_base]);
+	}
 	g_atm_priv_data.conn[conn].tx_skb[desc_base] = skb;
+	g_atm_priv_data.conn[conn].tx_inflight += skb->len;
 
 	spin_unlock_irqrestore(&g_atm_priv_data.conn[conn].lock, flags);
 
@@ -692,9 +712,13 @@ static int ppe_send_oam(struct atm_vcc *vcc, void *cell, int flags)
 		atomic_inc(&vcc->stats->tx);
 
 	/*  update descriptor send pointer  */
-	if ( g_atm_priv_data.conn[conn].tx_skb[desc_base] != NULL )
+	if ( g_atm_priv_data.conn[conn].tx_skb[desc_base] != NULL ) {
+		g_atm_priv_data.conn[conn].tx_inflight -= g_atm_priv_data.conn[conn].tx_skb[desc_base]->len;
+		g_atm_priv_data.conn[conn].tx_completed += g_atm_priv_data.conn[conn].tx_skb[desc_base]->len;
 		dev_kfree_skb_any(g_atm_priv_data.conn[conn].tx_skb[desc_base]);
+	}
 	g_atm_priv_data.conn[conn].tx_skb[desc_base] = skb;
+	g_atm_priv_data.conn[conn].tx_inflight += skb->len;
 
 	/*  write discriptor to memory and write back cache */
 	g_atm_priv_data.conn[conn].tx_desc[desc_base] = reg_desc;
@@ -724,6 +748,34 @@ static int ppe_change_qos(struct atm_vcc *vcc, struct atm_qos *qos, int flags)
 	return 0;
 }
 
+static int ppe_proc_read(struct atm_dev *dev, loff_t *pos, char *page)
+{
+	struct connection *connection;
+	int left = *pos;
+	int conn;
+
+	if ( !left-- )
+		return sprintf(page, "vpi.vci rx_pdu rx_backlog rx_backlog_drop rx_delay_avg(us) rx_delay_max(us) tx_inflight tx_completed\n");
+
+	for ( conn = 0; conn < MAX_PVC_NUMBER; conn++ ) {
+		connection = &g_atm_priv_data.conn[conn];
+		if ( connection->vcc == NULL || connection->vcc->dev != dev )
+			continue;
+		if ( left-- )
+			continue;
+
+		return sprintf(page, "%d.%d %u %u %u %llu %u %u %llu\n",
+			connection->vcc->vpi, connection->vcc->vci,
+			connection->rx_pdu, skb_queue_len(&connection->rx_queue),
+			connection->rx_backlog_drop,
+			connection->rx_pdu ? div_u64(connection->rx_delay_total, connection->rx_pdu) : 0,
+			connection->rx_delay_max,
+			connection->tx_inflight, connection->tx_completed);
+	}
+
+	return 0;
+}
+
 static inline void adsl_led_flash(void)
 {
 	ifx_mei_atm_led_blink();
@@ -835,6 +887,8 @@ static void free_tx_ring(unsigned int queue)
 		if (conn->tx_desc[i].own == 0 && conn->tx_skb[i] != NULL) {
 			skb = conn->tx_skb[i];
 			conn->tx_skb[i] = NULL;
+			conn->tx_inflight -= skb->len;
+			conn->tx_completed += skb->len;
 			atm_free_tx_skb_vcc(skb, ATM_SKB(skb)->vcc);
 		}
 	}
@@ -911,7 +965,12 @@ static inline void mailbox_oam_rx_handler(void)
 	}
 }
 
-static inline void mailbox_aal_rx_handler(void)
+/*
+ *  Take up to budget packets off the AAL RX ring and queue them on their
+ *  connection. The ring is shared by all VCCs, so it is always refilled,
+ *  but a VCC whose queue is full drops instead of holding up the others.
+ */
+static inline void mailbox_aal_rx_handler(int budget)
 {
 	unsigned int vlddes = WRX_DMA_CHANNEL_CONFIG(RX_DMA_CH_AAL)->vlddes;
 	struct rx_descriptor reg_desc;
@@ -921,6 +980,9 @@ static inline void mailbox_aal_rx_handler(void)
 	struct rx_inband_trailer *trailer;
 	unsigned int i;
 
+	if ( vlddes > budget )
+		vlddes = budget;
+
 	for ( i = 0; i < vlddes; i++ ) {
 		unsigned int loop_count = 0;
 
@@ -952,6 +1014,12 @@ static inline void mailbox_aal_rx_handler(void)
 					atomic_inc(&vcc->stats->rx_err);
 				}
 				reg_desc.err = 0;
+			} else if ( skb_queue_len(&g_atm_priv_data.conn[conn].rx_queue) >= rx_vcc_backlog ) {
+				g_atm_priv_data.conn[conn].rx_backlog_drop++;
+				if ( vcc->qos.aal == ATM_AAL5 )
+					g_atm_priv_data.wrx_drop_pdu++;
+				if ( vcc->stats )
+					atomic_inc(&vcc->stats->rx_drop);
 			} else if ( atm_charge(vcc, skb->truesize) ) {
 				new_skb = alloc_skb_rx();
 				if ( new_skb != NULL ) {
@@ -963,14 +1031,9 @@ static inline void mailbox_aal_rx_handler(void)
 					skb_reserve(skb, reg_desc.byteoff);
 					skb_put(skb, reg_desc.datalen);
 					ATM_SKB(skb)->vcc = vcc;
+					__net_timestamp(skb);
 
-					vcc->push(vcc, skb);
-
-					if ( vcc->qos.aal == ATM_AAL5 )
-						g_atm_priv_data.wrx_pdu++;
-					if ( vcc->stats )
-						atomic_inc(&vcc->stats->rx);
-					adsl_led_flash();
+					skb_queue_tail(&g_atm_priv_data.conn[conn].rx_queue, skb);
 
 					reg_desc.dataptr = (unsigned int)new_skb->data >> 2;
 				} else {
@@ -1003,13 +1066,78 @@ static inline void mailbox_aal_rx_handler(void)
 	}
 }
 
-static void do_ppe_tasklet(unsigned long data)
+/*
+ *  Push up to budget queued packets to the upper layer, taking one packet
+ *  from each connection in turn so a busy VCC can't delay the others.
+ */
+static int mailbox_aal_rx_push(int budget)
+{
+	unsigned int conn = g_atm_priv_data.rx_next_conn;
+	struct connection *connection;
+	struct atm_vcc *vcc;
+	struct sk_buff *skb;
+	unsigned int idle = 0;
+	int done = 0;
+	s64 delay;
+
+	while ( done < budget && idle < MAX_PVC_NUMBER ) {
+		connection = &g_atm_priv_data.conn[conn];
+		if ( ++conn == MAX_PVC_NUMBER )
+			conn = 0;
+
+		skb = skb_dequeue(&connection->rx_queue);
+		if ( skb == NULL ) {
+			idle++;
+			continue;
+		}
+		idle = 0;
+
+		delay = ktime_us_delta(ktime_get_real(), skb->tstamp);
+		if ( delay < 0 )
+			delay = 0;
+		connection->rx_delay_total += delay;
+		if ( delay > connection->rx_delay_max )
+			connection->rx_delay_max = delay;
+		connection->rx_pdu++;
+
+		vcc = ATM_SKB(skb)->vcc;
+		vcc->push(vcc, skb);
+
+		if ( vcc->qos.aal == ATM_AAL5 )
+			g_atm_priv_data.wrx_pdu++;
+		if ( vcc->stats )
+			atomic_inc(&vcc->stats->rx);
+		adsl_led_flash();
+
+		done++;
+	}
+
+	g_atm_priv_data.rx_next_conn = conn;
+
+	return done;
+}
+
+static int mailbox_aal_rx_pending(void)
+{
+	int i;
+
+	if ( WRX_DMA_CHANNEL_CONFIG(RX_DMA_CH_AAL)->vlddes )
+		return 1;
+
+	for ( i = 0; i < MAX_PVC_NUMBER; i++ )
+		if ( !skb_queue_empty(&g_atm_priv_data.conn[i].rx_queue) )
+			return 1;
+
+	return 0;
+}
+
+static int ppe_poll(struct napi_struct *napi, int budget)
 {
 	unsigned int irqs = *MBOX_IGU1_ISR;
-	*MBOX_IGU1_ISRC = *MBOX_IGU1_ISR;
+	int work_done;
+
+	*MBOX_IGU1_ISRC = irqs;
 
-	if (irqs & (1 << RX_DMA_CH_AAL))
-		mailbox_aal_rx_handler();
 	if (irqs & (1 << RX_DMA_CH_OAM))
 		mailbox_oam_rx_handler();
 
@@ -1017,12 +1145,18 @@ static void do_ppe_tasklet(unsigned long data)
 	if ((irqs >> (FIRST_QSB_QID + 16)) & g_atm_priv_data.conn_table)
 		mailbox_tx_handler(irqs >> (FIRST_QSB_QID + 16));
 
-	if ((*MBOX_IGU1_ISR & ((1 << RX_DMA_CH_AAL) | (1 << RX_DMA_CH_OAM))) != 0)
-		tasklet_schedule(&g_dma_tasklet);
-	else if (*MBOX_IGU1_ISR >> (FIRST_QSB_QID + 16)) /* TX queue */
-		tasklet_schedule(&g_dma_tasklet);
-	else
+	/* the ring is checked even without irq, a previous poll may have
+	 * left descriptors behind when it ran out of budget */
+	mailbox_aal_rx_handler(budget);
+	work_done = mailbox_aal_rx_push(budget);
+
+	if (work_done < budget && !mailbox_aal_rx_pending()) {
+		napi_complete_done(napi, work_done);
 		enable_irq(PPE_MAILBOX_IGU1_INT);
+		return work_done;
+	}
+
+	return budget;
 }
 
 static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
@@ -1031,7 +1165,7 @@ static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
 		return IRQ_HANDLED;
 
 	disable_irq_nosync(PPE_MAILBOX_IGU1_INT);
-	tasklet_schedule(&g_dma_tasklet);
+	napi_schedule(&g_atm_priv_data.napi);
 
 	return IRQ_HANDLED;
 }
@@ -1385,6 +1519,9 @@ static inline void check_parameters(void)
 
 	if ( dma_tx_descriptor_length < 2 )
 		dma_tx_descriptor_length = 2;
+
+	if ( rx_vcc_backlog < 1 )
+		rx_vcc_backlog = 1;
 }
 
 static inline int init_priv_data(void)
@@ -1478,6 +1615,7 @@ static inline int init_priv_data(void)
 	ppskb = (struct sk_buff **)(((unsigned int)g_atm_priv_data.tx_skb_base + 3) & ~3);
 	for ( i = 0; i < MAX_PVC_NUMBER; i++ ) {
 		spin_lock_init(&g_atm_priv_data.conn[i].lock);
+		skb_queue_head_init(&g_atm_priv_data.conn[i].rx_queue);
 		g_atm_priv_data.conn[i].tx_desc = &p_tx_desc[i * dma_tx_descriptor_length];
 		g_atm_priv_data.conn[i].tx_skb  = &ppskb[i * dma_tx_descriptor_length];
 	}
@@ -1805,6 +1943,15 @@ static int ltq_atm_probe(struct platform_device *pdev)
 		}
 	}
 
+	/*  RX and TX completion are handled in NAPI context    */
+	init_dummy_netdev(&g_atm_priv_data.napi_dev);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6,1,0)
+	netif_napi_add(&g_atm_priv_data.napi_dev, &g_atm_priv_data.napi, ppe_poll, NAPI_POLL_WEIGHT);
+#else
+	netif_napi_add(&g_atm_priv_data.napi_dev, &g_atm_priv_data.napi, ppe_poll);
+#endif
+	napi_enable(&g_atm_priv_data.napi);
+
 	/*  register interrupt handler  */
 	ret = request_irq(PPE_MAILBOX_IGU1_INT, mailbox_irq_handler, 0, "atm_mailbox_isr", &g_atm_priv_data);
 	if ( ret ) {
@@ -1847,6 +1994,8 @@ static int ltq_atm_probe(struct platform_device *pdev)
 PP32_START_FAIL:
 	free_irq(PPE_MAILBOX_IGU1_INT, &g_atm_priv_data);
 REQUEST_IRQ_PPE_MAILBOX_IGU1_INT_FAIL:
+	napi_disable(&g_atm_priv_data.napi);
+	netif_napi_del(&g_atm_priv_data.napi);
 ATM_DEV_REGISTER_FAIL:
 	while ( port_num-- > 0 )
 		atm_dev_deregister(g_atm_priv_data.port[port_num].dev);
@@ -1870,6 +2019,9 @@ static int ltq_atm_remove(struct platform_device *pdev)
 
 	free_irq(PPE_MAILBOX_IGU1_INT, &g_atm_priv_data);
 
+	napi_disable(&g_atm_priv_data.napi);
+	netif_napi_del(&g_atm_priv_data.napi);
+
 	for ( port_num = 0; port_num < ATM_PORT_NUMBER; port_num++ )
 		atm_dev_deregister(g_atm_priv_data.port[port_num].dev);
 
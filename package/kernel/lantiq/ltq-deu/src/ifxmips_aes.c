@@ -55,8 +55,11 @@
 #include <linux/crypto.h>
 #include <linux/interrupt.h>
 #include <linux/delay.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <asm/byteorder.h>
 #include <crypto/algapi.h>
+#include <crypto/authenc.h>
 #include <crypto/b128ops.h>
 #include <crypto/gcm.h>
 #include <crypto/gf128mul.h>
@@ -65,6 +68,11 @@
 #include <crypto/internal/aead.h>
 #include <crypto/internal/hash.h>
 #include <crypto/internal/skcipher.h>
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,11,0)
+#include <crypto/sha.h>
+#else
+#include <crypto/sha1.h>
+#endif
 
 #include "ifxmips_deu.h"
 
@@ -135,6 +143,7 @@ struct aes_ctx {
     u8 block[AES_BLOCK_SIZE];
     u8 hash[AES_BLOCK_SIZE];
     struct gf128mul_4k *gf128;
+    struct crypto_shash *hmac;
 };
 
 extern int disable_deudma;
@@ -1871,6 +1880,313 @@ struct aead_alg ifxdeu_gcm_aes_alg = {
     .setauthsize             =   gcm_aes_setauthsize,
 };
 
+/*! \fn int authenc_aes_set_key (struct crypto_aead *aead, const uint8_t *in_key, unsigned int key_len)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief sets the AES and HMAC keys for aead authenc
+ *  \param aead linux crypto aead
+ *  \param in_key authenc key blob holding both keys
+ *  \param key_len length of the key blob
+ *  \return -EINVAL - bad key, 0 - SUCCESS
+*/
+int authenc_aes_set_key (struct crypto_aead *aead, const u8 *in_key, unsigned int key_len)
+{
+    struct aes_ctx *ctx = crypto_aead_ctx(aead);
+    struct crypto_authenc_keys keys;
+    int err;
+
+    err = crypto_authenc_extractkeys(&keys, in_key, key_len);
+    if (err) goto out;
+
+    err = aes_set_key(&aead->base, keys.enckey, keys.enckeylen);
+    if (err) goto out;
+
+    err = crypto_shash_setkey(ctx->hmac, keys.authkey, keys.authkeylen);
+
+out:
+    memzero_explicit(&keys, sizeof(keys));
+    return err;
+}
+
+/*! \fn static int authenc_aes_assoc(struct aead_request *req, struct shash_desc *desc)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief hashes the associated data and copies it to the destination
+ *  \param req aead request
+ *  \param desc hmac descriptor
+ *  \return err
+*/
+static int authenc_aes_assoc(struct aead_request *req, struct shash_desc *desc)
+{
+    u8 buf[SHA1_BLOCK_SIZE];
+    unsigned int off, len;
+    int err = 0;
+
+    for (off = 0; !err && off < req->assoclen; off += len) {
+        len = min_t(unsigned int, req->assoclen - off, sizeof(buf));
+        scatterwalk_map_and_copy(buf, req->src, off, len, 0);
+        if (req->src != req->dst)
+            scatterwalk_map_and_copy(buf, req->dst, off, len, 1);
+        err = crypto_shash_update(desc, buf, len);
+    }
+
+    return err;
+}
+
+/*! \fn static int authenc_aes_do_encrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief CBC AES encrypt and HMAC SHA1 authenticate in a single pass
+ *  \param req aead request
+ *  \return err
+*/
+static int authenc_aes_do_encrypt(struct aead_request *req)
+{
+    struct crypto_aead *aead = crypto_aead_reqtfm(req);
+    struct aes_ctx *ctx = crypto_aead_ctx(aead);
+    SHASH_DESC_ON_STACK(desc, ctx->hmac);
+    struct skcipher_walk walk;
+    u8 digest[SHA1_DIGEST_SIZE];
+    unsigned int enc_bytes, nbytes;
+    int err;
+
+    if (req->cryptlen % AES_BLOCK_SIZE)
+        return -EINVAL;
+
+    desc->tfm = ctx->hmac;
+    err = crypto_shash_init(desc);
+    if (!err)
+        err = authenc_aes_assoc(req, desc);
+    if (err)
+        goto out;
+
+    err = skcipher_walk_aead_encrypt(&walk, req, false);
+
+    /* each chunk is hashed right after it was encrypted */
+    while ((nbytes = enc_bytes = walk.nbytes)) {
+        enc_bytes -= (nbytes % AES_BLOCK_SIZE);
+        ifx_deu_aes_cbc(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+                       walk.iv, enc_bytes, CRYPTO_DIR_ENCRYPT, 0);
+        err = crypto_shash_update(desc, walk.dst.virt.addr, enc_bytes);
+        nbytes &= AES_BLOCK_SIZE - 1;
+        err = skcipher_walk_done(&walk, err ? -EINVAL : nbytes);
+    }
+    if (err)
+        goto out;
+
+    err = crypto_shash_final(desc, digest);
+    if (err)
+        goto out;
+
+    scatterwalk_map_and_copy(digest, req->dst, req->assoclen + req->cryptlen,
+                             crypto_aead_authsize(aead), 1);
+
+out:
+    shash_desc_zero(desc);
+    return err;
+}
+
+/*! \fn static int authenc_aes_do_decrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief HMAC SHA1 verify and CBC AES decrypt in a single pass
+ *  \param req aead request
+ *  \return err
+*/
+static int authenc_aes_do_decrypt(struct aead_request *req)
+{
+    struct crypto_aead *aead = crypto_aead_reqtfm(req);
+    struct aes_ctx *ctx = crypto_aead_ctx(aead);
+    SHASH_DESC_ON_STACK(desc, ctx->hmac);
+    unsigned int authsize = crypto_aead_authsize(aead);
+    struct skcipher_walk walk;
+    u8 digest[SHA1_DIGEST_SIZE], tag[SHA1_DIGEST_SIZE];
+    unsigned int dec_bytes, nbytes;
+    int err;
+
+    if (req->cryptlen < authsize || (req->cryptlen - authsize) % AES_BLOCK_SIZE)
+        return -EINVAL;
+
+    desc->tfm = ctx->hmac;
+    err = crypto_shash_init(desc);
+    if (!err)
+        err = authenc_aes_assoc(req, desc);
+    if (err)
+        goto out;
+
+    err = skcipher_walk_aead_decrypt(&walk, req, false);
+
+    /* each chunk is hashed right before it gets decrypted */
+    while ((nbytes = dec_bytes = walk.nbytes)) {
+        dec_bytes -= (nbytes % AES_BLOCK_SIZE);
+        err = crypto_shash_update(desc, walk.src.virt.addr, dec_bytes);
+        ifx_deu_aes_cbc(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+                       walk.iv, dec_bytes, CRYPTO_DIR_DECRYPT, 0);
+        nbytes &= AES_BLOCK_SIZE - 1;
+        err = skcipher_walk_done(&walk, err ? -EINVAL : nbytes);
+    }
+    if (err)
+        goto out;
+
+    err = crypto_shash_final(desc, digest);
+    if (err)
+        goto out;
+
+    scatterwalk_map_and_copy(tag, req->src, req->assoclen + req->cryptlen - authsize,
+                             authsize, 0);
+    err = crypto_memneq(tag, digest, authsize) ? -EBADMSG : 0;
+
+out:
+    shash_desc_zero(desc);
+    return err;
+}
+
+/*
+ * The authenc requests are queued and processed by a worker, the walk
+ * may sleep and xfrm calls in from softirq context.
+ */
+#define AUTHENC_AES_QUEUE_LEN 128
+
+struct authenc_aes_reqctx {
+    bool encrypt;
+};
+
+static struct crypto_queue authenc_aes_queue;
+static DEFINE_SPINLOCK(authenc_aes_queue_lock);
+
+/*! \fn static void authenc_aes_work_fn(struct work_struct *work)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief processes all queued authenc requests
+ *  \param work work struct
+*/
+static void authenc_aes_work_fn(struct work_struct *work)
+{
+    struct crypto_async_request *async_req, *backlog;
+    struct authenc_aes_reqctx *rctx;
+    struct aead_request *req;
+    int err;
+
+    for (;;) {
+        spin_lock_bh(&authenc_aes_queue_lock);
+        backlog = crypto_get_backlog(&authenc_aes_queue);
+        async_req = crypto_dequeue_request(&authenc_aes_queue);
+        spin_unlock_bh(&authenc_aes_queue_lock);
+
+        if (!async_req)
+            break;
+
+        if (backlog)
+            backlog->complete(backlog, -EINPROGRESS);
+
+        req = aead_request_cast(async_req);
+        rctx = aead_request_ctx(req);
+        if (rctx->encrypt)
+            err = authenc_aes_do_encrypt(req);
+        else
+            err = authenc_aes_do_decrypt(req);
+
+        local_bh_disable();
+        aead_request_complete(req, err);
+        local_bh_enable();
+
+        cond_resched();
+    }
+}
+
+static DECLARE_WORK(authenc_aes_work, authenc_aes_work_fn);
+
+/*! \fn static int authenc_aes_enqueue(struct aead_request *req, bool encrypt)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief queues an authenc request for the worker
+ *  \param req aead request
+ *  \param encrypt true to encrypt, false to decrypt
+ *  \return -EINPROGRESS, -EBUSY if backlogged or -ENOSPC if the queue is full
+*/
+static int authenc_aes_enqueue(struct aead_request *req, bool encrypt)
+{
+    struct authenc_aes_reqctx *rctx = aead_request_ctx(req);
+    int err;
+
+    rctx->encrypt = encrypt;
+
+    spin_lock_bh(&authenc_aes_queue_lock);
+    err = crypto_enqueue_request(&authenc_aes_queue, &req->base);
+    spin_unlock_bh(&authenc_aes_queue_lock);
+
+    schedule_work(&authenc_aes_work);
+
+    return err;
+}
+
+/*! \fn int authenc_aes_encrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief queues an authenc encrypt request
+ *  \param req aead request
+ *  \return err
+*/
+int authenc_aes_encrypt(struct aead_request *req)
+{
+    return authenc_aes_enqueue(req, true);
+}
+
+/*! \fn int authenc_aes_decrypt(struct aead_request *req)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief queues an authenc decrypt request
+ *  \param req aead request
+ *  \return err
+*/
+int authenc_aes_decrypt(struct aead_request *req)
+{
+    return authenc_aes_enqueue(req, false);
+}
+
+/*! \fn static int authenc_aes_init_tfm(struct crypto_aead *aead)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief allocate the hmac transform of an authenc aead
+ *  \param aead linux crypto aead
+*/
+static int authenc_aes_init_tfm(struct crypto_aead *aead)
+{
+    struct aes_ctx *ctx = crypto_aead_ctx(aead);
+
+    ctx->hmac = crypto_alloc_shash("hmac(sha1)", 0, 0);
+    if (IS_ERR(ctx->hmac)) return PTR_ERR(ctx->hmac);
+
+    crypto_aead_set_reqsize(aead, sizeof(struct authenc_aes_reqctx));
+
+    return 0;
+}
+
+/*! \fn static void authenc_aes_exit_tfm(struct crypto_aead *aead)
+ *  \ingroup IFX_AES_FUNCTIONS
+ *  \brief free the hmac transform of an authenc aead
+ *  \param aead linux crypto aead
+*/
+static void authenc_aes_exit_tfm(struct crypto_aead *aead)
+{
+    struct aes_ctx *ctx = crypto_aead_ctx(aead);
+
+    crypto_free_shash(ctx->hmac);
+}
+
+/*
+ * \brief AES function mappings
+*/
+struct aead_alg ifxdeu_authenc_sha1_cbc_aes_alg = {
+    .base.cra_name           =   "authenc(hmac(sha1),cbc(aes))",
+    .base.cra_driver_name    =   "ifxdeu-authenc(hmac(sha1),cbc(aes))",
+    .base.cra_priority       =   400,
+    .base.cra_flags          =   CRYPTO_ALG_TYPE_AEAD | CRYPTO_ALG_KERN_DRIVER_ONLY | CRYPTO_ALG_ASYNC,
+    .base.cra_blocksize      =   AES_BLOCK_SIZE,
+    .base.cra_ctxsize        =   sizeof(struct aes_ctx),
+    .base.cra_module         =   THIS_MODULE,
+    .base.cra_list           =   LIST_HEAD_INIT(ifxdeu_authenc_sha1_cbc_aes_alg.base.cra_list),
+    .init                    =   authenc_aes_init_tfm,
+    .exit                    =   authenc_aes_exit_tfm,
+    .ivsize                  =   AES_BLOCK_SIZE,
+    .maxauthsize             =   SHA1_DIGEST_SIZE,
+    .chunksize               =   AES_BLOCK_SIZE,
+    .setkey                  =   authenc_aes_set_key,
+    .encrypt                 =   authenc_aes_encrypt,
+    .decrypt                 =   authenc_aes_decrypt,
+};
+
 /*! \fn int ifxdeu_init_aes (void)
  *  \ingroup IFX_AES_FUNCTIONS
  *  \brief function to initialize AES driver
@@ -1912,48 +2228,38 @@ int ifxdeu_init_aes (void)
     if ((ret = crypto_register_aead(&ifxdeu_gcm_aes_alg)))
         goto gcm_aes_err;
 
+    crypto_init_queue(&authenc_aes_queue, AUTHENC_AES_QUEUE_LEN);
+
+    if ((ret = crypto_register_aead(&ifxdeu_authenc_sha1_cbc_aes_alg)))
+        goto authenc_sha1_cbc_aes_err;
+
     CRTCL_SECT_INIT;
 
 
     printk (KERN_NOTICE "IFX DEU AES initialized%s%s.\n", disable_multiblock ? "" : " (multiblock)", disable_deudma ? "" : " (DMA)");
     return ret;
 
-gcm_aes_err:
+    /* only unregister what has been registered before the failure */
+authenc_sha1_cbc_aes_err:
     crypto_unregister_aead(&ifxdeu_gcm_aes_alg);
-    printk (KERN_ERR "IFX gcm_aes initialization failed!\n");
-    return ret;
-cbcmac_aes_err:
+gcm_aes_err:
     crypto_unregister_shash(&ifxdeu_cbcmac_aes_alg);
-    printk (KERN_ERR "IFX cbcmac_aes initialization failed!\n");
-    return ret;
-ctr_rfc3686_aes_err:
+cbcmac_aes_err:
     crypto_unregister_skcipher(&ifxdeu_ctr_rfc3686_aes_alg);
-    printk (KERN_ERR "IFX ctr_rfc3686_aes initialization failed!\n");
-    return ret;
-ctr_basic_aes_err:
+ctr_rfc3686_aes_err:
     crypto_unregister_skcipher(&ifxdeu_ctr_basic_aes_alg);
-    printk (KERN_ERR "IFX ctr_basic_aes initialization failed!\n");
-    return ret;
-cfb_aes_err:
+ctr_basic_aes_err:
     crypto_unregister_skcipher(&ifxdeu_cfb_aes_alg);
-    printk (KERN_ERR "IFX cfb_aes initialization failed!\n");
-    return ret;
-ofb_aes_err:
+cfb_aes_err:
     crypto_unregister_skcipher(&ifxdeu_ofb_aes_alg);
-    printk (KERN_ERR "IFX ofb_aes initialization failed!\n");
-    return ret;
-xts_aes_err:
+ofb_aes_err:
     crypto_unregister_skcipher(&ifxdeu_xts_aes_alg);
-    printk (KERN_ERR "IFX xts_aes initialization failed!\n");
-    return ret;
-cbc_aes_err:
+xts_aes_err:
     crypto_unregister_skcipher(&ifxdeu_cbc_aes_alg);
-    printk (KERN_ERR "IFX cbc_aes initialization failed!\n");
-    return ret;
-ecb_aes_err:
+cbc_aes_err:
     crypto_unregister_skcipher(&ifxdeu_ecb_aes_alg);
-    printk (KERN_ERR "IFX aes initialization failed!\n");
-    return ret;
+ecb_aes_err:
+    crypto_unregister_alg(&ifxdeu_aes_alg);
 aes_err:
     printk(KERN_ERR "IFX DEU AES initialization failed!\n");
 
@@ -1976,4 +2282,6 @@ void ifxdeu_fini_aes (void)
     crypto_unregister_skcipher (&ifxdeu_ctr_rfc3686_aes_alg);
     crypto_unregister_shash (&ifxdeu_cbcmac_aes_alg);
     crypto_unregister_aead (&ifxdeu_gcm_aes_alg);
+    crypto_unregister_aead (&ifxdeu_authenc_sha1_cbc_aes_alg);
+    flush_work (&authenc_aes_work);
 }
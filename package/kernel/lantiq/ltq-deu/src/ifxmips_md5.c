@@ -63,6 +63,8 @@
 #define MD5_BLOCK_WORDS     16
 #define MD5_HASH_WORDS      4
 #define HASH_START   IFX_HASH_CON
+/* upper bound of blocks hashed with interrupts disabled */
+#define MD5_SESSION_BLOCKS  32
 
 //#define CRYPTO_DEBUG
 #ifdef CRYPTO_DEBUG
@@ -81,13 +83,15 @@ struct md5_ctx {
 
 extern int disable_deudma;
 
-/*! \fn static void md5_transform(u32 *hash, u32 const *in)
+/*! \fn static void md5_transform(u32 *hash, u32 const *in, unsigned int blocks)
  *  \ingroup IFX_MD5_FUNCTIONS
  *  \brief main interface to md5 hardware   
  *  \param hash current hash value  
- *  \param in 64-byte block of input  
+ *  \param in consecutive 64-byte blocks of input  
+ *  \param blocks number of blocks, at most MD5_SESSION_BLOCKS  
 */                                 
-static void md5_transform(struct md5_ctx *mctx, u32 *hash, u32 const *in)
+static void md5_transform(struct md5_ctx *mctx, u32 *hash, u32 const *in,
+            unsigned int blocks)
 {
     int i;
     volatile struct deu_hash_t *hashs = (struct deu_hash_t *) HASH_START;
@@ -104,14 +108,20 @@ static void md5_transform(struct md5_ctx *mctx, u32 *hash, u32 const *in)
         hashs->D4R = *((u32 *) hash + 3);
     }
 
-    for (i = 0; i < 16; i++) {
-        hashs->MR = in[i];
-//      printk("in[%d]: %08x\n", i, in[i]);
-    };
+    /* all blocks are fed within one session, the engine keeps its
+     * state between them */
+    while (blocks--) {
+        for (i = 0; i < 16; i++) {
+            hashs->MR = in[i];
+//          printk("in[%d]: %08x\n", i, in[i]);
+        };
 
-    //wait for processing
-    while (hashs->controlr.BSY) {
-        // this will not take long
+        //wait for processing
+        while (hashs->controlr.BSY) {
+            // this will not take long
+        }
+
+        in += 16;
     }
 
     *((u32 *) hash + 0) = hashs->D1R;
@@ -132,7 +142,7 @@ static void md5_transform(struct md5_ctx *mctx, u32 *hash, u32 const *in)
 static inline void md5_transform_helper(struct md5_ctx *ctx)
 {
     //le32_to_cpu_array(ctx->block, sizeof(ctx->block) / sizeof(u32));
-    md5_transform(ctx, ctx->hash, ctx->block);
+    md5_transform(ctx, ctx->hash, ctx->block, 1);
 }
 
 /*! \fn static void md5_init(struct crypto_tfm *tfm)
@@ -177,6 +187,16 @@ static int md5_update(struct shash_desc *desc, const u8 *data, unsigned int len)
     data += avail;
     len -= avail;
 
+    /* aligned input is hashed in place, several blocks per session */
+    while (len >= sizeof(mctx->block) && IS_ALIGNED((unsigned long)data, 4)) {
+        unsigned int blocks = min_t(unsigned int, len / sizeof(mctx->block),
+                                    MD5_SESSION_BLOCKS);
+
+        md5_transform(mctx, mctx->hash, (const u32 *)data, blocks);
+        data += blocks * sizeof(mctx->block);
+        len -= blocks * sizeof(mctx->block);
+    }
+
     while (len >= sizeof(mctx->block)) {
         memcpy(mctx->block, data, sizeof(mctx->block));
         md5_transform_helper(mctx);
@@ -215,7 +235,7 @@ static int md5_final(struct shash_desc *desc, u8 *out)
     mctx->block[14] = le32_to_cpu(mctx->byte_count << 3);
     mctx->block[15] = le32_to_cpu(mctx->byte_count >> 29);
 
-    md5_transform(mctx, mctx->hash, mctx->block);                                                 
+    md5_transform(mctx, mctx->hash, mctx->block, 1);
 
     memcpy(out, mctx->hash, MD5_DIGEST_SIZE);
 
@@ -68,6 +68,8 @@
 #define SHA1_DIGEST_SIZE    20
 #define SHA1_HMAC_BLOCK_SIZE    64
 #define HASH_START   IFX_HASH_CON
+/* upper bound of blocks hashed with interrupts disabled */
+#define SHA1_SESSION_BLOCKS 32
 
 //#define CRYPTO_DEBUG
 #ifdef CRYPTO_DEBUG
@@ -90,13 +92,15 @@ struct sha1_ctx {
 
 extern int disable_deudma;
 
-/*! \fn static void sha1_transform1 (u32 *state, const u32 *in)
+/*! \fn static void sha1_transform1 (u32 *state, const u32 *in, unsigned int blocks)
  *  \ingroup IFX_SHA1_FUNCTIONS
  *  \brief main interface to sha1 hardware   
  *  \param state current state 
- *  \param in 64-byte block of input  
+ *  \param in consecutive 64-byte blocks of input  
+ *  \param blocks number of blocks, at most SHA1_SESSION_BLOCKS  
 */                                 
-static void sha1_transform1 (struct sha1_ctx *sctx, u32 *state, const u32 *in)
+static void sha1_transform1 (struct sha1_ctx *sctx, u32 *state, const u32 *in,
+            unsigned int blocks)
 {
     int i = 0;
     volatile struct deu_hash_t *hashs = (struct deu_hash_t *) HASH_START;
@@ -117,13 +121,20 @@ static void sha1_transform1 (struct sha1_ctx *sctx, u32 *state, const u32 *in)
         hashs->D5R = *((u32 *) sctx->hash + 4);
     }
 
-    for (i = 0; i < 16; i++) {
-        hashs->MR = in[i];
-    };
+    /* The engine keeps its state between blocks, so all of them are
+     * fed within one session without reloading the digest
+    */
+    while (blocks--) {
+        for (i = 0; i < 16; i++) {
+            hashs->MR = in[i];
+        };
+
+        //wait for processing
+        while (hashs->controlr.BSY) {
+            // this will not take long
+        }
 
-    //wait for processing
-    while (hashs->controlr.BSY) {
-        // this will not take long
+        in += 16;
     }
    
     /* For context switching purposes, the output is saved into a 
@@ -172,9 +183,13 @@ static int sha1_update(struct shash_desc * desc, const u8 *data,
 
     if ((j + len) > 63) {
         memcpy (&sctx->buffer[j], data, (i = 64 - j));
-        sha1_transform1 (sctx, sctx->state, (const u32 *)sctx->buffer);
-        for (; i + 63 < len; i += 64) {
-            sha1_transform1 (sctx, sctx->state, (const u32 *)&data[i]);
+        sha1_transform1 (sctx, sctx->state, (const u32 *)sctx->buffer, 1);
+        while (i + 63 < len) {
+            unsigned int blocks = min_t(unsigned int, (len - i) / 64,
+                                        SHA1_SESSION_BLOCKS);
+
+            sha1_transform1 (sctx, sctx->state, (const u32 *)&data[i], blocks);
+            i += blocks * 64;
         }
 
         j = 0;
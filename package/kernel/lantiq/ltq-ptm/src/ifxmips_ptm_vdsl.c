@@ -76,6 +76,13 @@ static int ptm_stop(struct net_device *);
   static unsigned int ptm_poll(int, unsigned int);
   static int ptm_napi_poll(struct napi_struct *, int);
 static int ptm_hard_start_xmit(struct sk_buff *, struct net_device *);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,2,0)
+static u16 ptm_select_queue(struct net_device *, struct sk_buff *, struct net_device *, select_queue_fallback_t);
+#else
+static u16 ptm_select_queue(struct net_device *, struct sk_buff *, struct net_device *);
+#endif
+static void ptm_tx_reclaim(struct net_device *);
+static void ptm_tx_complete(struct net_device *);
 static int ptm_ioctl(struct net_device *, struct ifreq *, int);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,6,0)
 static void ptm_tx_timeout(struct net_device *);
@@ -118,6 +125,7 @@ static struct net_device_ops g_ptm_netdev_ops = {
     .ndo_open            = ptm_open,
     .ndo_stop            = ptm_stop,
     .ndo_start_xmit      = ptm_hard_start_xmit,
+    .ndo_select_queue    = ptm_select_queue,
     .ndo_validate_addr   = eth_validate_addr,
     .ndo_set_mac_address = eth_mac_addr,
     .ndo_do_ioctl        = ptm_ioctl,
@@ -151,6 +159,8 @@ static void ptm_setup(struct net_device *dev, int ndev)
     netif_carrier_off(dev);
 
     dev->netdev_ops      = &g_ptm_netdev_ops;
+    /*  room for the skb pointer and burst alignment, avoids copies in xmit  */
+    dev->needed_headroom = sizeof(struct sk_buff *) + DATA_BUFFER_ALIGNMENT;
     /* Allow up to 1508 bytes, for RFC4638 */
     dev->max_mtu         = ETH_DATA_LEN + 8;
     netif_napi_add(dev, &g_ptm_priv_data.itf[ndev].napi, ptm_napi_poll, 16);
@@ -184,20 +194,31 @@ static int ptm_open(struct net_device *dev)
 
     IFX_REG_W32_MASK(0, 1, MBOX_IGU1_IER);
 
-    netif_start_queue(dev);
+    netif_tx_start_all_queues(dev);
 
     return 0;
 }
 
 static int ptm_stop(struct net_device *dev)
 {
+    struct ptm_itf *p_itf = &g_ptm_priv_data.itf[0];
+    unsigned int i;
+
     ASSERT(dev == g_net_dev[0], "incorrect device");
 
     IFX_REG_W32_MASK(1 | (1 << 17), 0, MBOX_IGU1_IER);
 
-    napi_disable(&g_ptm_priv_data.itf[0].napi);
+    napi_disable(&p_itf->napi);
 
-    netif_stop_queue(dev);
+    netif_tx_stop_all_queues(dev);
+
+    /*  forget pending BQL accounting, buffers are released on reuse   */
+    spin_lock_bh(&p_itf->tx_lock);
+    memset(p_itf->tx_len, 0, sizeof(p_itf->tx_len));
+    p_itf->tx_done_pos = p_itf->tx_desc_pos;
+    spin_unlock_bh(&p_itf->tx_lock);
+    for ( i = 0; i < dev->num_tx_queues; i++ )
+        netdev_tx_reset_queue(netdev_get_tx_queue(dev, i));
 
     return 0;
 }
@@ -260,6 +281,8 @@ static int ptm_napi_poll(struct napi_struct *napi, int budget)
     int ndev = 0;
     unsigned int work_done;
 
+    ptm_tx_complete(napi->dev);
+
     work_done = ptm_poll(ndev, budget);
 
     //  interface down
@@ -281,14 +304,65 @@ static int ptm_napi_poll(struct napi_struct *napi, int budget)
     return work_done;
 }
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,2,0)
+static u16 ptm_select_queue(struct net_device *dev, struct sk_buff *skb, struct net_device *sb_dev, select_queue_fallback_t fallback)
+#else
+static u16 ptm_select_queue(struct net_device *dev, struct sk_buff *skb, struct net_device *sb_dev)
+#endif
+{
+    //  TX queue index is the firmware QoS queue
+    return g_ptm_prio_queue_map[skb->priority > 7 ? 7 : skb->priority];
+}
+
+/*
+ *  Report descriptors PP32 has taken since last call to BQL.
+ *  Called with tx_lock held.
+ */
+static void ptm_tx_reclaim(struct net_device *dev)
+{
+    struct ptm_itf *p_itf = &g_ptm_priv_data.itf[0];
+    unsigned int pkts[MAX_TX_QUEUE_NUMBER] = {0};
+    unsigned int bytes[MAX_TX_QUEUE_NUMBER] = {0};
+    unsigned int pos = p_itf->tx_done_pos;
+    unsigned int qid;
+
+    while ( p_itf->tx_len[pos] != 0 && CPU_TO_WAN_TX_DESC_BASE[pos].own == 0 ) {
+        qid = p_itf->tx_qid[pos];
+        pkts[qid]++;
+        bytes[qid] += p_itf->tx_len[pos];
+        p_itf->tx_len[pos] = 0;
+        if ( ++pos == CPU_TO_WAN_TX_DESC_NUM )
+            pos = 0;
+    }
+    p_itf->tx_done_pos = pos;
+
+    for ( qid = 0; qid < dev->real_num_tx_queues; qid++ )
+        if ( pkts[qid] != 0 )
+            netdev_tx_completed_queue(netdev_get_tx_queue(dev, qid), pkts[qid], bytes[qid]);
+}
+
+static void ptm_tx_complete(struct net_device *dev)
+{
+    struct ptm_itf *p_itf = &g_ptm_priv_data.itf[0];
+
+    spin_lock_bh(&p_itf->tx_lock);
+    ptm_tx_reclaim(dev);
+    if ( CPU_TO_WAN_TX_DESC_BASE[p_itf->tx_desc_pos].own == 0 )
+        netif_tx_wake_all_queues(dev);
+    spin_unlock_bh(&p_itf->tx_lock);
+}
+
 static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
+    struct ptm_itf *p_itf = &g_ptm_priv_data.itf[0];
+    struct netdev_queue *txq;
     unsigned int f_full;
     int desc_base;
     volatile struct tx_descriptor *desc;
     struct tx_descriptor reg_desc = {0};
     struct sk_buff *skb_to_free;
     unsigned int byteoff;
+    unsigned int qid;
 
     ASSERT(dev == g_net_dev[0], "incorrect device");
 
@@ -297,26 +371,16 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
         goto PTM_HARD_START_XMIT_FAIL;
     }
 
-    /*  allocate descriptor */
-    desc_base = get_tx_desc(0, &f_full);
-    if ( f_full ) {
-        netif_trans_update(dev);
-        netif_stop_queue(dev);
-
-        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_ISRC);
-        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_IER);
-    }
-    if ( desc_base < 0 )
-        goto PTM_HARD_START_XMIT_FAIL;
-    desc = &CPU_TO_WAN_TX_DESC_BASE[desc_base];
-
+    /*
+     *  The buffer is handed to the firmware, which may swap it with another one,
+     *  and is later found again through the skb pointer stored in front of it.
+     *  Data shared with a clone can't carry that pointer, so copy it.
+     *  needed_headroom makes the headroom check a rare case.
+     */
     byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
     if ( skb_headroom(skb) < sizeof(struct sk_buff *) + byteoff || skb_cloned(skb) ) {
         struct sk_buff *new_skb;
 
-        ASSERT(skb_headroom(skb) >= sizeof(struct sk_buff *) + byteoff, "skb_headroom(skb) < sizeof(struct sk_buff *) + byteoff");
-        ASSERT(!skb_cloned(skb), "skb is cloned");
-
         new_skb = alloc_skb_tx(skb->len);
         if ( new_skb == NULL ) {
             dbg("no memory");
@@ -324,13 +388,15 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
         }
         skb_put(new_skb, skb->len);
         memcpy(new_skb->data, skb->data, skb->len);
+        new_skb->queue_mapping = skb->queue_mapping;
         dev_kfree_skb_any(skb);
         skb = new_skb;
         byteoff = (unsigned int)skb->data & (DATA_BUFFER_ALIGNMENT - 1);
-        /*  write back to physical memory   */
-        dma_cache_wback((unsigned long)skb->data, skb->len);
     }
 
+    qid = skb_get_queue_mapping(skb);
+    txq = netdev_get_tx_queue(dev, qid);
+
     /* make the skb unowned */
     skb_orphan(skb);
 
@@ -338,6 +404,25 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
     /*  write back to physical memory   */
     dma_cache_wback((unsigned long)skb->data - byteoff - sizeof(struct sk_buff *), skb->len + byteoff + sizeof(struct sk_buff *));
 
+    spin_lock(&p_itf->tx_lock);
+
+    ptm_tx_reclaim(dev);
+
+    /*  allocate descriptor */
+    desc_base = get_tx_desc(0, &f_full);
+    if ( f_full ) {
+        netif_trans_update(dev);
+        netif_tx_stop_all_queues(dev);
+
+        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_ISRC);
+        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_IER);
+    }
+    if ( desc_base < 0 ) {
+        spin_unlock(&p_itf->tx_lock);
+        goto PTM_HARD_START_XMIT_FAIL;
+    }
+    desc = &CPU_TO_WAN_TX_DESC_BASE[desc_base];
+
     /*  free previous skb   */
     skb_to_free = get_skb_pointer(desc->dataptr);
     if ( skb_to_free != NULL )
@@ -347,7 +432,7 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
     reg_desc.small   = 0;
     reg_desc.dataptr = (unsigned int)skb->data & (0x0FFFFFFF ^ (DATA_BUFFER_ALIGNMENT - 1));
     reg_desc.datalen = skb->len < ETH_ZLEN ? ETH_ZLEN : skb->len;
-    reg_desc.qid     = g_ptm_prio_queue_map[skb->priority > 7 ? 7 : skb->priority];
+    reg_desc.qid     = qid;
     reg_desc.byteoff = byteoff;
     reg_desc.own     = 1;
     reg_desc.c       = 1;
@@ -357,11 +442,25 @@ static int ptm_hard_start_xmit(struct sk_buff *skb, struct net_device *dev)
     g_ptm_priv_data.itf[0].stats.tx_packets++;
     g_ptm_priv_data.itf[0].stats.tx_bytes += reg_desc.datalen;
 
+    p_itf->tx_len[desc_base] = reg_desc.datalen;
+    p_itf->tx_qid[desc_base] = qid;
+
     /*  write discriptor to memory  */
     *((volatile unsigned int *)desc + 1) = *((unsigned int *)&reg_desc + 1);
     wmb();
     *(volatile unsigned int *)desc = *(unsigned int *)&reg_desc;
 
+    netdev_tx_sent_queue(txq, reg_desc.datalen);
+    if ( !f_full && netif_xmit_stopped(txq) ) {
+        /*  BQL stopped the queue, get an interrupt when PP32 takes descriptors */
+        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_ISRC);
+        IFX_REG_W32_MASK(0, 1 << 17, MBOX_IGU1_IER);
+        /*  catch up with descriptors taken before the interrupt was armed  */
+        ptm_tx_reclaim(dev);
+    }
+
+    spin_unlock(&p_itf->tx_lock);
+
     netif_trans_update(dev);
 
     return 0;
@@ -449,7 +548,8 @@ static int ptm_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
             if ( cmd.pkt_prio < 0 || cmd.pkt_prio >= ARRAY_SIZE(g_ptm_prio_queue_map) )
                 return -EINVAL;
 
-            if ( cmd.qid < 0 || cmd.qid >= g_wanqos_en )
+            //  the qid is also used as TX queue index by ptm_select_queue
+            if ( cmd.qid < 0 || cmd.qid >= g_wanqos_en || cmd.qid >= dev->real_num_tx_queues )
                 return -EINVAL;
 
             g_ptm_prio_queue_map[cmd.pkt_prio] = cmd.qid;
@@ -474,7 +574,7 @@ static void ptm_tx_timeout(struct net_device *dev, unsigned int txqueue)
     IFX_REG_W32_MASK(1 << 17, 0, MBOX_IGU1_IER);
 
     /*  wake up TX queue    */
-    netif_wake_queue(dev);
+    netif_tx_wake_all_queues(dev);
 
     return;
 }
@@ -584,7 +684,8 @@ static irqreturn_t mailbox_irq_handler(int irq, void *dev_id)
             }
 	    if (isr & BIT(17)) {
                 IFX_REG_W32_MASK(1 << 17, 0, MBOX_IGU1_IER);
-                netif_wake_queue(g_net_dev[0]);
+                //  TX descriptors released, reclaim and wake queues from NAPI
+                napi_schedule(&g_ptm_priv_data.itf[0].napi);
         	}
 
     return IRQ_HANDLED;
@@ -652,9 +753,9 @@ static inline int init_priv_data(void)
 {
     int i, j;
 
-    g_wanqos_en = wanqos_en ? wanqos_en : 8;
-    if ( g_wanqos_en > 8 )
-        g_wanqos_en = 8;
+    g_wanqos_en = wanqos_en ? wanqos_en : MAX_TX_QUEUE_NUMBER;
+    if ( g_wanqos_en > MAX_TX_QUEUE_NUMBER )
+        g_wanqos_en = MAX_TX_QUEUE_NUMBER;
 
     for ( i = 0; i < ARRAY_SIZE(g_queue_gamma_map); i++ )
     {
@@ -664,6 +765,8 @@ static inline int init_priv_data(void)
     }
 
     memset(&g_ptm_priv_data, 0, sizeof(g_ptm_priv_data));
+    for ( i = 0; i < ARRAY_SIZE(g_ptm_priv_data.itf); i++ )
+        spin_lock_init(&g_ptm_priv_data.itf[i].tx_lock);
 
     {
         int max_packet_priority = ARRAY_SIZE(g_ptm_prio_queue_map);
@@ -997,7 +1100,7 @@ static int ltq_ptm_probe(struct platform_device *pdev)
     }
 
     for ( i = 0; i < ARRAY_SIZE(g_net_dev); i++ ) {
-        g_net_dev[i] = alloc_netdev(0, g_net_dev_name[i], NET_NAME_UNKNOWN, ether_setup);
+        g_net_dev[i] = alloc_netdev_mqs(0, g_net_dev_name[i], NET_NAME_UNKNOWN, ether_setup, __ETH_WAN_TX_QUEUE_NUM, 1);
         if ( g_net_dev[i] == NULL )
             goto ALLOC_NETDEV_FAIL;
         ptm_setup(g_net_dev[i], i);
@@ -57,6 +57,7 @@
 #define MAX_ITF_NUMBER                  1
 #define MAX_RX_DMA_CHANNEL_NUMBER       1
 #define MAX_TX_DMA_CHANNEL_NUMBER       1
+#define MAX_TX_QUEUE_NUMBER             8
 #define DATA_BUFFER_ALIGNMENT           EMA_ALIGNMENT
 #define DESC_ALIGNMENT                  8
 
@@ -92,6 +93,12 @@ struct ptm_itf {
 
     unsigned int                    tx_swap_desc_pos;
 
+    /*  CPU to WAN TX descriptors are shared by all TX queues   */
+    spinlock_t                      tx_lock;
+    unsigned int                    tx_done_pos;
+    unsigned short                  tx_len[CPU_TO_WAN_TX_DESC_NUM];     //  bytes queued per descriptor (BQL), 0 if idle
+    unsigned char                   tx_qid[CPU_TO_WAN_TX_DESC_NUM];
+
     struct net_device_stats         stats;
 
     struct napi_struct              napi;
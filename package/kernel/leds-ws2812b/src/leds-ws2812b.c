@@ -8,6 +8,10 @@
  * is transferred as 3'b110 and a zero pulse is 3'b100. For this driver to
  * work properly, the SPI frequency should be 2.105MHz~2.85MHz and it needs
  * to transfer all the bytes continuously.
+ *
+ * Brightness changes only update the encoded frame in memory. The frame is
+ * sent by a delayed work shortly afterwards, so updates of several LEDs
+ * (or colours) within the coalescing window end up in one SPI transfer.
  */
 
 #include <linux/led-class-multicolor.h>
@@ -17,12 +21,18 @@
 #include <linux/property.h>
 #include <linux/spi/spi.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
 #include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #define WS2812B_BYTES_PER_COLOR 3
 #define WS2812B_NUM_COLORS 3
 /* A continuous 0 for 50us+ as the 'reset' signal */
 #define WS2812B_RESET_LEN 18
+/* Window in which brightness changes are merged into one frame */
+#define WS2812B_COALESCE_MS 5
 
 struct ws2812b_led {
 	struct led_classdev_mc mc_cdev;
@@ -37,6 +47,23 @@ struct ws2812b_priv {
 	int num_leds;
 	size_t data_len;
 	u8 *data_buf;
+
+	/* frame currently on the wire, data_buf keeps being updated */
+	u8 *tx_buf;
+	struct spi_transfer xfer;
+	struct spi_message msg;
+	struct delayed_work work;
+	/* woken up when busy drops */
+	wait_queue_head_t idle_wq;
+	spinlock_t lock;
+	bool busy;
+	bool dirty;
+	bool stopping;
+
+	unsigned long frames_sent;
+	unsigned long frames_merged;
+	unsigned long frames_dropped;
+
 	struct ws2812b_led leds[];
 };
 
@@ -79,6 +106,98 @@ static void ws2812b_set_byte(struct ws2812b_priv *priv, size_t offset, u8 val)
 	p[2] = l3b[val & 0x7]; /* Bit 2-0 */
 }
 
+/**
+ * ws2812b_queue_frame - schedule transmission of the current frame
+ * @priv: pointer to the private data structure
+ *
+ * Must be called after data_buf has been updated. If a frame is already
+ * waiting to be sent, the update is merged into it.
+ */
+static void ws2812b_queue_frame(struct ws2812b_priv *priv)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	if (priv->dirty)
+		priv->frames_merged++;
+	priv->dirty = true;
+	if (!priv->busy && !priv->stopping)
+		schedule_delayed_work(&priv->work,
+				      msecs_to_jiffies(WS2812B_COALESCE_MS));
+	spin_unlock_irqrestore(&priv->lock, flags);
+}
+
+static void ws2812b_xfer_complete(void *context)
+{
+	struct ws2812b_priv *priv = context;
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	if (priv->msg.status)
+		priv->frames_dropped++;
+	else
+		priv->frames_sent++;
+	priv->busy = false;
+	/* changes made while this frame was on the wire */
+	if (priv->dirty && !priv->stopping)
+		schedule_delayed_work(&priv->work, 0);
+	/*
+	 * Wake up under the lock: once it is dropped, ws2812b_stop() may see
+	 * the queue idle and free everything.
+	 */
+	wake_up(&priv->idle_wq);
+	spin_unlock_irqrestore(&priv->lock, flags);
+}
+
+static bool ws2812b_idle(struct ws2812b_priv *priv)
+{
+	unsigned long flags;
+	bool idle;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	idle = !priv->busy;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	return idle;
+}
+
+static void ws2812b_work(struct work_struct *work)
+{
+	struct ws2812b_priv *priv =
+		container_of(to_delayed_work(work), struct ws2812b_priv, work);
+	unsigned long flags;
+	int ret;
+
+	mutex_lock(&priv->mutex);
+	spin_lock_irqsave(&priv->lock, flags);
+	if (priv->busy || !priv->dirty) {
+		spin_unlock_irqrestore(&priv->lock, flags);
+		mutex_unlock(&priv->mutex);
+		return;
+	}
+	priv->busy = true;
+	priv->dirty = false;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	memcpy(priv->tx_buf, priv->data_buf, priv->data_len);
+	mutex_unlock(&priv->mutex);
+
+	spi_message_init_with_transfers(&priv->msg, &priv->xfer, 1);
+	priv->msg.complete = ws2812b_xfer_complete;
+	priv->msg.context = priv;
+
+	ret = spi_async(priv->spi, &priv->msg);
+	if (ret) {
+		dev_err_ratelimited(&priv->spi->dev,
+				    "failed to send frame: %d\n", ret);
+		spin_lock_irqsave(&priv->lock, flags);
+		priv->frames_dropped++;
+		priv->busy = false;
+		wake_up(&priv->idle_wq);
+		spin_unlock_irqrestore(&priv->lock, flags);
+	}
+}
+
 static int ws2812b_set(struct led_classdev *cdev,
 		       enum led_brightness brightness)
 {
@@ -86,7 +205,6 @@ static int ws2812b_set(struct led_classdev *cdev,
 	struct ws2812b_led *led =
 		container_of(mc_cdev, struct ws2812b_led, mc_cdev);
 	struct ws2812b_priv *priv = dev_get_drvdata(cdev->dev->parent);
-	int ret;
 	int i;
 
 	led_mc_calc_color_components(mc_cdev, brightness);
@@ -95,10 +213,92 @@ static int ws2812b_set(struct led_classdev *cdev,
 	for (i = 0; i < WS2812B_NUM_COLORS; i++)
 		ws2812b_set_byte(priv, led->cascade * WS2812B_NUM_COLORS + i,
 				 led->subled[i].brightness);
-	ret = spi_write(priv->spi, priv->data_buf, priv->data_len);
 	mutex_unlock(&priv->mutex);
 
-	return ret;
+	ws2812b_queue_frame(priv);
+
+	return 0;
+}
+
+/*
+ * Raw colour bytes for the whole chain, in wire order: num_leds * 3 bytes,
+ * usually G, R, B per LED. Partial writes at an offset are allowed. The
+ * brightness shown by the individual LED class devices is not updated.
+ */
+static ssize_t frame_write(struct file *filp, struct kobject *kobj,
+			   struct bin_attribute *attr, char *buf,
+			   loff_t off, size_t count)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct ws2812b_priv *priv = spi_get_drvdata(to_spi_device(dev));
+	size_t len = priv->num_leds * WS2812B_NUM_COLORS;
+	size_t i;
+
+	if (off >= len)
+		return -EFBIG;
+	if (count > len - off)
+		count = len - off;
+
+	mutex_lock(&priv->mutex);
+	for (i = 0; i < count; i++)
+		ws2812b_set_byte(priv, off + i, buf[i]);
+	mutex_unlock(&priv->mutex);
+
+	ws2812b_queue_frame(priv);
+
+	return count;
+}
+static BIN_ATTR_WO(frame, 0);
+
+#define WS2812B_STAT_ATTR(_name)					\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct ws2812b_priv *priv = spi_get_drvdata(to_spi_device(dev));\
+									\
+	return sprintf(buf, "%lu\n", READ_ONCE(priv->_name));		\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+WS2812B_STAT_ATTR(frames_sent);
+WS2812B_STAT_ATTR(frames_merged);
+WS2812B_STAT_ATTR(frames_dropped);
+
+static struct attribute *ws2812b_attrs[] = {
+	&dev_attr_frames_sent.attr,
+	&dev_attr_frames_merged.attr,
+	&dev_attr_frames_dropped.attr,
+	NULL,
+};
+
+static struct bin_attribute *ws2812b_bin_attrs[] = {
+	&bin_attr_frame,
+	NULL,
+};
+
+static const struct attribute_group ws2812b_group = {
+	.attrs = ws2812b_attrs,
+	.bin_attrs = ws2812b_bin_attrs,
+};
+
+static const struct attribute_group *ws2812b_groups[] = {
+	&ws2812b_group,
+	NULL,
+};
+
+static void ws2812b_stop(struct ws2812b_priv *priv)
+{
+	unsigned long flags;
+
+	/* push out the last state before shutting the queue down */
+	flush_delayed_work(&priv->work);
+
+	spin_lock_irqsave(&priv->lock, flags);
+	priv->stopping = true;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	cancel_delayed_work_sync(&priv->work);
+	wait_event(priv->idle_wq, ws2812b_idle(priv));
 }
 
 static int ws2812b_probe(struct spi_device *spi)
@@ -120,13 +320,24 @@ static int ws2812b_probe(struct spi_device *spi)
 	priv->data_buf = kzalloc(priv->data_len, GFP_KERNEL);
 	if (!priv->data_buf)
 		return -ENOMEM;
+	priv->tx_buf = kzalloc(priv->data_len, GFP_KERNEL);
+	if (!priv->tx_buf) {
+		kfree(priv->data_buf);
+		return -ENOMEM;
+	}
 
 	for (i = 0; i < num_leds * WS2812B_NUM_COLORS; i++)
 		ws2812b_set_byte(priv, i, 0);
 
 	mutex_init(&priv->mutex);
+	spin_lock_init(&priv->lock);
+	INIT_DELAYED_WORK(&priv->work, ws2812b_work);
+	init_waitqueue_head(&priv->idle_wq);
+	priv->xfer.tx_buf = priv->tx_buf;
+	priv->xfer.len = priv->data_len;
 	priv->num_leds = num_leds;
 	priv->spi = spi;
+	spi_set_drvdata(spi, priv);
 
 	device_for_each_child_node(dev, led_node) {
 		struct led_init_data init_data = {
@@ -181,13 +392,14 @@ static int ws2812b_probe(struct spi_device *spi)
 		cur_led++;
 	}
 
-	spi_set_drvdata(spi, priv);
-
 	return 0;
 ERR_UNREG_LEDS:
-	for (; cur_led >= 0; cur_led--)
+	/* leds[cur_led] itself has not been registered */
+	while (--cur_led >= 0)
 		led_classdev_multicolor_unregister(&priv->leds[cur_led].mc_cdev);
+	ws2812b_stop(priv);
 	mutex_destroy(&priv->mutex);
+	kfree(priv->tx_buf);
 	kfree(priv->data_buf);
 	return ret;
 }
@@ -203,6 +415,8 @@ static int ws2812b_remove(struct spi_device *spi)
 
 	for (cur_led = priv->num_leds - 1; cur_led >= 0; cur_led--)
 		led_classdev_multicolor_unregister(&priv->leds[cur_led].mc_cdev);
+	ws2812b_stop(priv);
+	kfree(priv->tx_buf);
 	kfree(priv->data_buf);
 	mutex_destroy(&priv->mutex);
 
@@ -230,6 +444,7 @@ static struct spi_driver ws2812b_driver = {
 	.driver = {
 		.name		= KBUILD_MODNAME,
 		.of_match_table	= ws2812b_dt_ids,
+		.dev_groups	= ws2812b_groups,
 	},
 };
 
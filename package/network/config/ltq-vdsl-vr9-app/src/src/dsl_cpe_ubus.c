@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "dsl_cpe_control.h"
@@ -144,9 +145,31 @@ enum {
 	RAMODE_MAP_DYNAMIC_SOS,
 };
 
+/* Snapshots are refreshed at most once per interval (ms). Subscribers
+ * of the dsl object are sent only the fields that changed since the
+ * previous snapshot, under the method name of the group.
+ */
+#define METRICS_INTERVAL	5000
+#define STATISTICS_INTERVAL	60000
+
+enum {
+	GROUP_METRICS,
+	GROUP_STATISTICS,
+};
+
+struct dsl_group {
+	const char *name;
+	void (*collect)(int fd, int fd_mei);
+	int interval;
+	int64_t stamp;
+	struct blob_attr *data;
+	struct uloop_timeout timer;
+};
+
 static DSL_CPE_ThreadCtrl_t thread;
 static struct ubus_context *ctx;
 static struct blob_buf b;
+static int dev_fd = -1, mei_fd = -1;
 
 static inline void m_null() {
 	blobmsg_add_field(&b, BLOBMSG_TYPE_UNSPEC, "", NULL, 0);
@@ -915,23 +938,9 @@ static void describe_mode(standard_t standard, profile_t profile, vector_t vecto
 	m_str("mode", buf);
 }
 
-static int line_statistics(struct ubus_context *ctx, struct ubus_object *obj,
-                   struct ubus_request_data *req, const char *method,
-                   struct blob_attr *msg)
-{
-	int fd;
+static void collect_statistics(int fd, int fd_mei) {
 	void *c, *c2;
 
-#ifndef INCLUDE_DSL_CPE_API_DANUBE
-	fd = open(DSL_CPE_DEVICE_NAME "/0", O_RDWR, 0644);
-#else
-	fd = open(DSL_CPE_DEVICE_NAME, O_RDWR, 0644);
-#endif
-	if (fd < 0)
-		return UBUS_STATUS_UNKNOWN_ERROR;
-
-	blob_buf_init(&b, 0);
-
 	pilot_tones_status(fd);
 
 	c = blobmsg_open_table(&b, "bands");
@@ -978,41 +987,15 @@ static int line_statistics(struct ubus_context *ctx, struct ubus_object *obj,
 	g977_get_hlog(fd, DSL_UPSTREAM);
 	blobmsg_close_table(&b, c2);
 	blobmsg_close_table(&b, c);
-
-	ubus_send_reply(ctx, req, b.head);
-
-	close(fd);
-
-	return 0;
 }
 
-static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
-		   struct ubus_request_data *req, const char *method,
-		   struct blob_attr *msg)
-{
-	int fd, fd_mei;
+static void collect_metrics(int fd, int fd_mei) {
 	void *c, *c2;
 	standard_t standard = STD_UNKNOWN;
 	profile_t profile = PROFILE_UNKNOWN;
 	vector_t vector = VECTOR_UNKNOWN;
 	bool retx_up = false, retx_down = false;
 
-#ifndef INCLUDE_DSL_CPE_API_DANUBE
-	fd = open(DSL_CPE_DEVICE_NAME "/0", O_RDWR, 0644);
-#else
-	fd = open(DSL_CPE_DEVICE_NAME, O_RDWR, 0644);
-#endif
-	if (fd < 0)
-		return UBUS_STATUS_UNKNOWN_ERROR;
-
-#ifdef INCLUDE_DSL_CPE_API_VRX
-	fd_mei = open(DSL_CPE_DSL_LOW_DEV "/0", O_RDWR, 0644);
-#else
-	fd_mei = -1;
-#endif
-
-	blob_buf_init(&b, 0);
-
 	version_information(fd);
 	line_state(fd);
 	pm_channel_counters_showtime(fd);
@@ -1111,16 +1094,200 @@ static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
 	default:
 		break;
 	};
+}
+
+static void group_timer(struct uloop_timeout *t);
+static struct ubus_object dsl_object;
+
+static struct dsl_group groups[] = {
+	[GROUP_METRICS] = {
+		.name = "metrics",
+		.collect = collect_metrics,
+		.interval = METRICS_INTERVAL,
+		.timer.cb = group_timer,
+	},
+	[GROUP_STATISTICS] = {
+		.name = "statistics",
+		.collect = collect_statistics,
+		.interval = STATISTICS_INTERVAL,
+		.timer.cb = group_timer,
+	},
+};
+
+static int64_t now_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int dsl_open(void) {
+	if (dev_fd >= 0)
+		return 0;
+
+#ifndef INCLUDE_DSL_CPE_API_DANUBE
+	dev_fd = open(DSL_CPE_DEVICE_NAME "/0", O_RDWR, 0644);
+#else
+	dev_fd = open(DSL_CPE_DEVICE_NAME, O_RDWR, 0644);
+#endif
+	if (dev_fd < 0)
+		return -1;
+
+#ifdef INCLUDE_DSL_CPE_API_VRX
+	mei_fd = open(DSL_CPE_DSL_LOW_DEV "/0", O_RDWR, 0644);
+#endif
+
+	return 0;
+}
 
-	ubus_send_reply(ctx, req, b.head);
+static struct blob_attr *m_find(struct blob_attr *data, size_t len, const char *name) {
+	struct blob_attr *cur;
+	size_t rem = len;
 
-	if (fd_mei >= 0)
-		close(fd_mei);
-	close(fd);
+	__blob_for_each_attr(cur, data, rem)
+		if (!strcmp(blobmsg_name(cur), name))
+			return cur;
+
+	return NULL;
+}
+
+/* Add every entry of a table that differs from the previous snapshot,
+ * descending into nested tables. Entries that disappeared are reported
+ * as null.
+ */
+static void m_changes(struct blob_attr *prev, size_t prev_len,
+		      struct blob_attr *data, size_t len) {
+	struct blob_attr *cur, *old;
+	size_t rem = len;
+	void *c;
+
+	__blob_for_each_attr(cur, data, rem) {
+		old = m_find(prev, prev_len, blobmsg_name(cur));
+		if (old && blob_attr_equal(old, cur))
+			continue;
+
+		if (old && blobmsg_type(old) == BLOBMSG_TYPE_TABLE &&
+		    blobmsg_type(cur) == BLOBMSG_TYPE_TABLE) {
+			c = blobmsg_open_table(&b, blobmsg_name(cur));
+			m_changes(blobmsg_data(old), blobmsg_data_len(old),
+				  blobmsg_data(cur), blobmsg_data_len(cur));
+			blobmsg_close_table(&b, c);
+			continue;
+		}
+
+		blobmsg_add_blob(&b, cur);
+	}
+
+	rem = prev_len;
+	__blob_for_each_attr(old, prev, rem)
+		if (!m_find(data, len, blobmsg_name(old)))
+			blobmsg_add_field(&b, BLOBMSG_TYPE_UNSPEC, blobmsg_name(old), NULL, 0);
+}
+
+static bool m_field_equal(struct blob_attr *prev, struct blob_attr *data, const char *name) {
+	struct blob_attr *old = m_find(blob_data(prev), blob_len(prev), name);
+	struct blob_attr *cur = m_find(blob_data(data), blob_len(data), name);
+
+	if (!old || !cur)
+		return old == cur;
+
+	return blob_attr_equal(old, cur);
+}
+
+static int group_update(struct dsl_group *g) {
+	struct blob_attr *prev = g->data;
+	struct dsl_group *stats = &groups[GROUP_STATISTICS];
+
+	if (dsl_open())
+		return UBUS_STATUS_UNKNOWN_ERROR;
+
+	blob_buf_init(&b, 0);
+	g->collect(dev_fd, mei_fd);
+
+	g->data = blob_memdup(b.head);
+	if (!g->data) {
+		g->data = prev;
+		return UBUS_STATUS_UNKNOWN_ERROR;
+	}
+	g->stamp = now_ms();
+
+	if (!prev)
+		return 0;
+
+	if (dsl_object.has_subscribers) {
+		blob_buf_init(&b, 0);
+		m_changes(blob_data(prev), blob_len(prev),
+			  blob_data(g->data), blob_len(g->data));
+		if (blob_len(b.head))
+			ubus_notify(ctx, &dsl_object, g->name, b.head, -1);
+	}
+
+	/* per-tone data belongs to a single sync, drop it on line state changes */
+	if (g == &groups[GROUP_METRICS] && !m_field_equal(prev, g->data, "state_num")) {
+		stats->stamp = 0;
+		if (dsl_object.has_subscribers)
+			uloop_timeout_set(&stats->timer, 0);
+	}
+
+	free(prev);
 
 	return 0;
 }
 
+static int group_reply(struct ubus_context *ctx, struct ubus_request_data *req,
+		       struct dsl_group *g) {
+	int ret;
+
+	if (!g->data || now_ms() - g->stamp >= g->interval) {
+		ret = group_update(g);
+		if (ret)
+			return ret;
+	}
+
+	ubus_send_reply(ctx, req, g->data);
+
+	return 0;
+}
+
+static void group_timer(struct uloop_timeout *t) {
+	struct dsl_group *g = container_of(t, struct dsl_group, timer);
+	int64_t age;
+
+	if (!dsl_object.has_subscribers)
+		return;
+
+	age = now_ms() - g->stamp;
+	if (age >= g->interval) {
+		group_update(g);
+		age = 0;
+	}
+
+	uloop_timeout_set(t, g->interval - age);
+}
+
+static int metrics(struct ubus_context *ctx, struct ubus_object *obj,
+		   struct ubus_request_data *req, const char *method,
+		   struct blob_attr *msg)
+{
+	return group_reply(ctx, req, &groups[GROUP_METRICS]);
+}
+
+static int line_statistics(struct ubus_context *ctx, struct ubus_object *obj,
+                   struct ubus_request_data *req, const char *method,
+                   struct blob_attr *msg)
+{
+	return group_reply(ctx, req, &groups[GROUP_STATISTICS]);
+}
+
+static void dsl_subscribe(struct ubus_context *ctx, struct ubus_object *obj) {
+	for (size_t i = 0; i < ARRAY_SIZE(groups); i++)
+		if (obj->has_subscribers)
+			uloop_timeout_set(&groups[i].timer, 0);
+		else
+			uloop_timeout_cancel(&groups[i].timer);
+}
+
 static const struct ubus_method dsl_methods[] = {
 	UBUS_METHOD_NOARG("metrics", metrics),
 	UBUS_METHOD_NOARG("statistics", line_statistics)
@@ -1134,6 +1301,7 @@ static struct ubus_object dsl_object = {
 	.type = &dsl_object_type,
 	.methods = dsl_methods,
 	.n_methods = ARRAY_SIZE(dsl_methods),
+	.subscribe_cb = dsl_subscribe,
 };
 
 static DSL_int_t ubus_main(DSL_CPE_Thread_Params_t *params) {
@@ -1167,4 +1335,15 @@ void ubus_deinit() {
 	uloop_done();
 
 	DSL_CPE_ThreadShutdown(&thread, 1000);
+
+	for (size_t i = 0; i < ARRAY_SIZE(groups); i++) {
+		free(groups[i].data);
+		groups[i].data = NULL;
+	}
+
+	if (mei_fd >= 0)
+		close(mei_fd);
+	if (dev_fd >= 0)
+		close(dev_fd);
+	mei_fd = dev_fd = -1;
 }
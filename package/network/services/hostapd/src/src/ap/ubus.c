@@ -24,6 +24,7 @@
 #include "taxonomy.h"
 #include "airtime_policy.h"
 #include "hw_features.h"
+#include "ieee802_11.h"
 
 static struct ubus_context *ctx;
 static struct blob_buf b;
@@ -235,16 +236,152 @@ hostapd_parse_capab_blobmsg(struct sta_info *sta)
 	blobmsg_close_table(&b, v);
 }
 
+enum {
+	GET_CLIENTS_ADDR,
+	GET_CLIENTS_FIELDS,
+	__GET_CLIENTS_MAX
+};
+
+static const struct blobmsg_policy get_clients_policy[__GET_CLIENTS_MAX] = {
+	[GET_CLIENTS_ADDR] = { "address", BLOBMSG_TYPE_ARRAY },
+	[GET_CLIENTS_FIELDS] = { "fields", BLOBMSG_TYPE_ARRAY },
+};
+
+enum {
+	CLIENT_FIELD_FLAGS = BIT(0),
+	CLIENT_FIELD_RRM = BIT(1),
+	CLIENT_FIELD_EXT_CAPA = BIT(2),
+	CLIENT_FIELD_SIGNATURE = BIT(3),
+	CLIENT_FIELD_STATS = BIT(4),
+	CLIENT_FIELD_CAPABILITIES = BIT(5),
+};
+
+static const struct {
+	const char *name;
+	uint32_t field;
+} client_fields[] = {
+	{ "flags", CLIENT_FIELD_FLAGS },
+	{ "rrm", CLIENT_FIELD_RRM },
+	{ "extended_capabilities", CLIENT_FIELD_EXT_CAPA },
+	{ "signature", CLIENT_FIELD_SIGNATURE },
+	{ "stats", CLIENT_FIELD_STATS },
+	{ "capabilities", CLIENT_FIELD_CAPABILITIES },
+};
+
+struct get_clients_sta_data {
+	u8 addr[ETH_ALEN];
+	struct hostap_sta_driver_data data;
+};
+
+struct get_clients_dump {
+	struct get_clients_sta_data *sta;
+	size_t len, size;
+};
+
+static void
+hostapd_get_clients_dump_cb(void *ctx, const u8 *addr,
+			    struct hostap_sta_driver_data *data)
+{
+	struct get_clients_dump *dump = ctx;
+	struct get_clients_sta_data *sta;
+
+	if (dump->len == dump->size) {
+		sta = os_realloc_array(dump->sta, dump->size * 2 + 16,
+				       sizeof(*sta));
+		if (!sta)
+			return;
+
+		dump->sta = sta;
+		dump->size = dump->size * 2 + 16;
+	}
+
+	sta = &dump->sta[dump->len++];
+	memcpy(sta->addr, addr, ETH_ALEN);
+	sta->data = *data;
+}
+
+static struct hostap_sta_driver_data *
+hostapd_get_clients_dump_find(struct get_clients_dump *dump, const u8 *addr,
+			      size_t *hint)
+{
+	size_t i, idx;
+
+	/* the dump is usually in sta_list order, so start at the last hit */
+	for (i = 0; i < dump->len; i++) {
+		idx = (*hint + i) % dump->len;
+		if (memcmp(dump->sta[idx].addr, addr, ETH_ALEN) != 0)
+			continue;
+
+		*hint = idx + 1;
+		return &dump->sta[idx].data;
+	}
+
+	return NULL;
+}
+
+static bool
+hostapd_get_clients_match(struct blob_attr *addrs, const u8 *addr)
+{
+	struct blob_attr *cur;
+	u8 match[ETH_ALEN];
+	int rem;
+
+	if (!addrs)
+		return true;
+
+	blobmsg_for_each_attr(cur, addrs, rem) {
+		if (blobmsg_type(cur) != BLOBMSG_TYPE_STRING ||
+		    hwaddr_aton(blobmsg_data(cur), match))
+			continue;
+
+		if (!memcmp(match, addr, ETH_ALEN))
+			return true;
+	}
+
+	return false;
+}
+
+static void
+hostapd_add_sta_driver_data(struct hostap_sta_driver_data *sta_driver_data)
+{
+	void *r;
+
+	r = blobmsg_open_table(&b, "bytes");
+	blobmsg_add_u64(&b, "rx", sta_driver_data->rx_bytes);
+	blobmsg_add_u64(&b, "tx", sta_driver_data->tx_bytes);
+	blobmsg_close_table(&b, r);
+	r = blobmsg_open_table(&b, "airtime");
+	blobmsg_add_u64(&b, "rx", sta_driver_data->rx_airtime);
+	blobmsg_add_u64(&b, "tx", sta_driver_data->tx_airtime);
+	blobmsg_close_table(&b, r);
+	r = blobmsg_open_table(&b, "packets");
+	blobmsg_add_u32(&b, "rx", sta_driver_data->rx_packets);
+	blobmsg_add_u32(&b, "tx", sta_driver_data->tx_packets);
+	blobmsg_close_table(&b, r);
+	r = blobmsg_open_table(&b, "rate");
+	/* Rate in kbits */
+	blobmsg_add_u32(&b, "rx", sta_driver_data->current_rx_rate * 100);
+	blobmsg_add_u32(&b, "tx", sta_driver_data->current_tx_rate * 100);
+	blobmsg_close_table(&b, r);
+	blobmsg_add_u32(&b, "signal", sta_driver_data->signal);
+}
+
 static int
 hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 			struct ubus_request_data *req, const char *method,
 			struct blob_attr *msg)
 {
 	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
-	struct hostap_sta_driver_data sta_driver_data;
+	struct hostap_sta_driver_data sta_driver_data, *sta_data;
+	struct blob_attr *tb[__GET_CLIENTS_MAX], *cur;
+	struct get_clients_dump dump = {};
 	struct sta_info *sta;
+	uint32_t fields = ~0;
+	bool dumped = false;
+	size_t hint = 0;
 	void *list, *c;
 	char mac_buf[20];
+	int rem;
 	static const struct {
 		const char *name;
 		uint32_t flag;
@@ -262,6 +399,37 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 		{ "mfp", WLAN_STA_MFP },
 	};
 
+	blobmsg_parse(get_clients_policy, __GET_CLIENTS_MAX, tb, blob_data(msg), blob_len(msg));
+
+	if (tb[GET_CLIENTS_FIELDS]) {
+		fields = 0;
+		blobmsg_for_each_attr(cur, tb[GET_CLIENTS_FIELDS], rem) {
+			int i;
+
+			if (blobmsg_type(cur) != BLOBMSG_TYPE_STRING)
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			for (i = 0; i < ARRAY_SIZE(client_fields); i++)
+				if (!strcmp(blobmsg_get_string(cur), client_fields[i].name))
+					break;
+
+			if (i == ARRAY_SIZE(client_fields))
+				return UBUS_STATUS_INVALID_ARGUMENT;
+
+			fields |= client_fields[i].field;
+		}
+	}
+
+	/*
+	 * Fetch the driver data of all stations with a single dump instead
+	 * of one request per station, unless only a few are asked for.
+	 */
+	if ((fields & CLIENT_FIELD_STATS) && hapd->num_sta > 1 &&
+	    (!tb[GET_CLIENTS_ADDR] ||
+	     blobmsg_check_array(tb[GET_CLIENTS_ADDR], BLOBMSG_TYPE_STRING) > 1))
+		dumped = hostapd_drv_read_sta_data_all(hapd, hostapd_get_clients_dump_cb,
+						       &dump) >= 0;
+
 	blob_buf_init(&b, 0);
 	blobmsg_add_u32(&b, "freq", hapd->iface->freq);
 	list = blobmsg_open_table(&b, "clients");
@@ -269,66 +437,72 @@ hostapd_bss_get_clients(struct ubus_context *ctx, struct ubus_object *obj,
 		void *r;
 		int i;
 
+		if (!hostapd_get_clients_match(tb[GET_CLIENTS_ADDR], sta->addr))
+			continue;
+
 		sprintf(mac_buf, MACSTR, MAC2STR(sta->addr));
 		c = blobmsg_open_table(&b, mac_buf);
-		for (i = 0; i < ARRAY_SIZE(sta_flags); i++)
-			blobmsg_add_u8(&b, sta_flags[i].name,
-				       !!(sta->flags & sta_flags[i].flag));
+
+		if (fields & CLIENT_FIELD_FLAGS) {
+			for (i = 0; i < ARRAY_SIZE(sta_flags); i++)
+				blobmsg_add_u8(&b, sta_flags[i].name,
+					       !!(sta->flags & sta_flags[i].flag));
 
 #ifdef CONFIG_MBO
-		blobmsg_add_u8(&b, "mbo", !!(sta->cell_capa));
+			blobmsg_add_u8(&b, "mbo", !!(sta->cell_capa));
 #endif
+		}
 
-		r = blobmsg_open_array(&b, "rrm");
-		for (i = 0; i < ARRAY_SIZE(sta->rrm_enabled_capa); i++)
-			blobmsg_add_u32(&b, "", sta->rrm_enabled_capa[i]);
-		blobmsg_close_array(&b, r);
+		if (fields & CLIENT_FIELD_RRM) {
+			r = blobmsg_open_array(&b, "rrm");
+			for (i = 0; i < ARRAY_SIZE(sta->rrm_enabled_capa); i++)
+				blobmsg_add_u32(&b, "", sta->rrm_enabled_capa[i]);
+			blobmsg_close_array(&b, r);
+		}
 
-		r = blobmsg_open_array(&b, "extended_capabilities");
-		/* Check if client advertises extended capabilities */
-		if (sta->ext_capability && sta->ext_capability[0] > 0) {
-			for (i = 0; i < sta->ext_capability[0]; i++) {
-				blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
+		if (fields & CLIENT_FIELD_EXT_CAPA) {
+			r = blobmsg_open_array(&b, "extended_capabilities");
+			/* Check if client advertises extended capabilities */
+			if (sta->ext_capability && sta->ext_capability[0] > 0) {
+				for (i = 0; i < sta->ext_capability[0]; i++) {
+					blobmsg_add_u32(&b, "", sta->ext_capability[1 + i]);
+				}
 			}
+			blobmsg_close_array(&b, r);
 		}
-		blobmsg_close_array(&b, r);
 
 		blobmsg_add_u32(&b, "aid", sta->aid);
 #ifdef CONFIG_TAXONOMY
-		r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
-		if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
-			blobmsg_add_string_buffer(&b);
+		if (fields & CLIENT_FIELD_SIGNATURE) {
+			r = blobmsg_alloc_string_buffer(&b, "signature", 1024);
+			if (retrieve_sta_taxonomy(hapd, sta, r, 1024) > 0)
+				blobmsg_add_string_buffer(&b);
+		}
 #endif
 
 		/* Driver information */
-		if (hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0) {
-			r = blobmsg_open_table(&b, "bytes");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_bytes);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_bytes);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "airtime");
-			blobmsg_add_u64(&b, "rx", sta_driver_data.rx_airtime);
-			blobmsg_add_u64(&b, "tx", sta_driver_data.tx_airtime);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "packets");
-			blobmsg_add_u32(&b, "rx", sta_driver_data.rx_packets);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.tx_packets);
-			blobmsg_close_table(&b, r);
-			r = blobmsg_open_table(&b, "rate");
-			/* Rate in kbits */
-			blobmsg_add_u32(&b, "rx", sta_driver_data.current_rx_rate * 100);
-			blobmsg_add_u32(&b, "tx", sta_driver_data.current_tx_rate * 100);
-			blobmsg_close_table(&b, r);
-			blobmsg_add_u32(&b, "signal", sta_driver_data.signal);
+		if (fields & CLIENT_FIELD_STATS) {
+			if (dumped)
+				sta_data = hostapd_get_clients_dump_find(&dump, sta->addr, &hint);
+			else if (hostapd_drv_read_sta_data(hapd, &sta_driver_data, sta->addr) >= 0)
+				sta_data = &sta_driver_data;
+			else
+				sta_data = NULL;
+
+			if (sta_data)
+				hostapd_add_sta_driver_data(sta_data);
 		}
 
-		hostapd_parse_capab_blobmsg(sta);
+		if (fields & CLIENT_FIELD_CAPABILITIES)
+			hostapd_parse_capab_blobmsg(sta);
 
 		blobmsg_close_table(&b, c);
 	}
 	blobmsg_close_array(&b, list);
 	ubus_send_reply(ctx, req, b.head);
 
+	os_free(dump.sta);
+
 	return 0;
 }
 
@@ -353,7 +527,7 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 		       struct blob_attr *msg)
 {
 	struct hostapd_data *hapd = container_of(obj, struct hostapd_data, ubus.obj);
-	void *airtime_table, *dfs_table, *rrm_table, *wnm_table;
+	void *airtime_table, *dfs_table, *rrm_table, *wnm_table, *admission_table;
 	struct os_reltime now;
 	char ssid[SSID_MAX_LEN + 1];
 	char phy_name[17];
@@ -402,6 +576,16 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 	blobmsg_add_u64(&b, "bss_transition_response_rx", hapd->openwrt_stats.wnm.bss_transition_response_rx);
 	blobmsg_close_table(&b, wnm_table);
 
+	/* Admission */
+	admission_table = blobmsg_open_table(&b, "admission");
+	blobmsg_add_u64(&b, "cache_hit", hapd->ubus.admission_stats.cache_hit);
+	blobmsg_add_u64(&b, "cache_miss", hapd->ubus.admission_stats.cache_miss);
+	blobmsg_add_u64(&b, "deferred", hapd->ubus.admission_stats.deferred);
+	blobmsg_add_u64(&b, "dropped", hapd->ubus.admission_stats.dropped);
+	blobmsg_add_u64(&b, "timeout", hapd->ubus.admission_stats.timeout);
+	blobmsg_add_u32(&b, "pending", hapd->ubus.n_admission_reqs);
+	blobmsg_close_table(&b, admission_table);
+
 	/* Airtime */
 	airtime_table = blobmsg_open_table(&b, "airtime");
 	blobmsg_add_u64(&b, "time", hapd->iface->last_channel_time);
@@ -425,13 +609,19 @@ hostapd_bss_get_status(struct ubus_context *ctx, struct ubus_object *obj,
 
 enum {
 	NOTIFY_RESPONSE,
+	NOTIFY_VERDICT_TTL,
+	NOTIFY_RESPONSE_TIMEOUT,
 	__NOTIFY_MAX
 };
 
 static const struct blobmsg_policy notify_policy[__NOTIFY_MAX] = {
 	[NOTIFY_RESPONSE] = { "notify_response", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_VERDICT_TTL] = { "verdict_ttl", BLOBMSG_TYPE_INT32 },
+	[NOTIFY_RESPONSE_TIMEOUT] = { "response_timeout", BLOBMSG_TYPE_INT32 },
 };
 
+static void hostapd_ubus_admission_flush(struct hostapd_data *hapd);
+
 static int
 hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 			struct ubus_request_data *req, const char *method,
@@ -450,6 +640,13 @@ hostapd_notify_response(struct ubus_context *ctx, struct ubus_object *obj,
 		return UBUS_STATUS_INVALID_ARGUMENT;
 
 	hapd->ubus.notify_response = blobmsg_get_u32(tb[NOTIFY_RESPONSE]);
+	if (tb[NOTIFY_VERDICT_TTL])
+		hapd->ubus.verdict_ttl = blobmsg_get_u32(tb[NOTIFY_VERDICT_TTL]);
+	if (tb[NOTIFY_RESPONSE_TIMEOUT])
+		hapd->ubus.response_timeout = blobmsg_get_u32(tb[NOTIFY_RESPONSE_TIMEOUT]);
+
+	/* the subscriber's policy may have changed */
+	hostapd_ubus_admission_flush(hapd);
 
 	return UBUS_STATUS_OK;
 }
@@ -1615,7 +1812,7 @@ hostapd_bss_get_sta_ies(struct ubus_context *ctx, struct ubus_object *obj,
 
 static const struct ubus_method bss_methods[] = {
 	UBUS_METHOD_NOARG("reload", hostapd_bss_reload),
-	UBUS_METHOD_NOARG("get_clients", hostapd_bss_get_clients),
+	UBUS_METHOD("get_clients", hostapd_bss_get_clients, get_clients_policy),
 #ifdef CONFIG_TAXONOMY
 	UBUS_METHOD("get_sta_ies", hostapd_bss_get_sta_ies, addr_policy),
 #endif
@@ -1656,6 +1853,22 @@ static int avl_compare_macaddr(const void *k1, const void *k2, void *ptr)
 	return memcmp(k1, k2, ETH_ALEN);
 }
 
+#define ADMISSION_MAX_VERDICTS		1024
+#define ADMISSION_MAX_REQS		64
+#define ADMISSION_MAX_FRAMES		4
+#define ADMISSION_DEFAULT_TTL		5000
+#define ADMISSION_DEFAULT_TIMEOUT	100
+
+struct ubus_admission_key {
+	u8 addr[ETH_ALEN];
+	u8 type;
+};
+
+static int avl_compare_admission_key(const void *k1, const void *k2, void *ptr)
+{
+	return memcmp(k1, k2, sizeof(struct ubus_admission_key));
+}
+
 void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 {
 	struct ubus_object *obj = &hapd->ubus.obj;
@@ -1674,6 +1887,10 @@ void hostapd_ubus_add_bss(struct hostapd_data *hapd)
 		return;
 
 	avl_init(&hapd->ubus.banned, avl_compare_macaddr, false, NULL);
+	avl_init(&hapd->ubus.verdicts, avl_compare_admission_key, false, NULL);
+	INIT_LIST_HEAD(&hapd->ubus.admission_reqs);
+	hapd->ubus.verdict_ttl = ADMISSION_DEFAULT_TTL;
+	hapd->ubus.response_timeout = ADMISSION_DEFAULT_TIMEOUT;
 	obj->name = name;
 	obj->type = &bss_object_type;
 	obj->methods = bss_object_type.methods;
@@ -1695,6 +1912,8 @@ void hostapd_ubus_free_bss(struct hostapd_data *hapd)
 	if (!ctx)
 		return;
 
+	hostapd_ubus_admission_flush(hapd);
+
 	if (obj->id) {
 		ubus_remove_object(ctx, obj);
 		hostapd_ubus_ref_dec();
@@ -1753,6 +1972,298 @@ ubus_event_cb(struct ubus_notify_request *req, int idx, int ret)
 	ureq->resp = ret;
 }
 
+struct ubus_admission_req;
+
+/* verdict being applied while deferred frames are fed back */
+static struct ubus_verdict *admission_replay;
+
+struct ubus_verdict {
+	struct avl_node avl;
+	struct ubus_admission_key key;
+	struct os_reltime expire;
+	struct ubus_admission_req *req;
+	int resp;
+};
+
+struct ubus_deferred_frame {
+	struct list_head list;
+	struct hostapd_frame_info fi;
+	size_t len;
+	u8 data[];
+};
+
+/*
+ * A probe/auth/assoc notification waiting for the subscribers' verdict.
+ * Frames of the same station and type are queued on it and fed back to
+ * ieee802_11_mgmt() once the verdict is cached.
+ */
+struct ubus_admission_req {
+	struct ubus_notify_request nreq;
+	struct list_head list;
+	struct hostapd_data *hapd;
+	struct ubus_verdict *verdict;
+	struct list_head frames;
+	int n_frames;
+	int resp;
+};
+
+static void
+hostapd_ubus_verdict_free(struct hostapd_data *hapd, struct ubus_verdict *v)
+{
+	avl_delete(&hapd->ubus.verdicts, &v->avl);
+	os_free(v);
+}
+
+static void
+hostapd_ubus_verdicts_expire(struct hostapd_data *hapd)
+{
+	struct ubus_verdict *v, *tmp;
+	struct os_reltime now;
+
+	os_get_reltime(&now);
+	avl_for_each_element_safe(&hapd->ubus.verdicts, v, avl, tmp)
+		if (!v->req && os_reltime_before(&v->expire, &now))
+			hostapd_ubus_verdict_free(hapd, v);
+}
+
+static struct ubus_verdict *
+hostapd_ubus_verdict_get(struct hostapd_data *hapd,
+			 struct ubus_admission_key *key)
+{
+	struct ubus_verdict *v;
+	struct os_reltime now;
+
+	v = avl_find_element(&hapd->ubus.verdicts, key, v, avl);
+	if (!v || v->req)
+		return v;
+
+	os_get_reltime(&now);
+	if (os_reltime_before(&v->expire, &now)) {
+		hostapd_ubus_verdict_free(hapd, v);
+		return NULL;
+	}
+
+	return v;
+}
+
+static struct ubus_verdict *
+hostapd_ubus_verdict_new(struct hostapd_data *hapd,
+			 struct ubus_admission_key *key)
+{
+	struct ubus_verdict *v;
+
+	if (hapd->ubus.verdicts.count >= ADMISSION_MAX_VERDICTS) {
+		hostapd_ubus_verdicts_expire(hapd);
+		if (hapd->ubus.verdicts.count >= ADMISSION_MAX_VERDICTS)
+			return NULL;
+	}
+
+	v = os_zalloc(sizeof(*v));
+	if (!v)
+		return NULL;
+
+	v->key = *key;
+	v->avl.key = &v->key;
+	avl_insert(&hapd->ubus.verdicts, &v->avl);
+
+	return v;
+}
+
+static void hostapd_ubus_admission_timeout(void *eloop_data, void *user_ctx);
+
+static void
+hostapd_ubus_admission_done(struct ubus_admission_req *areq)
+{
+	struct hostapd_data *hapd = areq->hapd;
+	struct ubus_verdict *v = areq->verdict;
+	struct ubus_deferred_frame *f, *tmp;
+	struct list_head frames;
+
+	eloop_cancel_timeout(hostapd_ubus_admission_timeout, areq, NULL);
+	list_del(&areq->list);
+	hapd->ubus.n_admission_reqs--;
+
+	os_get_reltime(&v->expire);
+	v->expire.sec += hapd->ubus.verdict_ttl / 1000;
+	v->expire.usec += (hapd->ubus.verdict_ttl % 1000) * 1000;
+	if (v->expire.usec >= 1000000) {
+		v->expire.sec++;
+		v->expire.usec -= 1000000;
+	}
+	v->resp = areq->resp;
+	v->req = NULL;
+
+	INIT_LIST_HEAD(&frames);
+	list_splice_init(&areq->frames, &frames);
+	os_free(areq);
+
+	admission_replay = v;
+	list_for_each_entry_safe(f, tmp, &frames, list) {
+		list_del(&f->list);
+		ieee802_11_mgmt(hapd, f->data, f->len, &f->fi);
+		os_free(f);
+	}
+	admission_replay = NULL;
+}
+
+static void
+hostapd_ubus_admission_status_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	struct ubus_admission_req *areq = container_of(req, struct ubus_admission_req, nreq);
+
+	/* any subscriber may reject the station */
+	if (ret && !areq->resp)
+		areq->resp = ret;
+}
+
+static void
+hostapd_ubus_admission_complete_cb(struct ubus_notify_request *req, int idx, int ret)
+{
+	hostapd_ubus_admission_done(container_of(req, struct ubus_admission_req, nreq));
+}
+
+static void
+hostapd_ubus_admission_timeout(void *eloop_data, void *user_ctx)
+{
+	struct ubus_admission_req *areq = eloop_data;
+
+	areq->hapd->ubus.admission_stats.timeout++;
+	ubus_abort_request(ctx, &areq->nreq.req);
+	hostapd_ubus_admission_done(areq);
+}
+
+static void
+hostapd_ubus_admission_flush(struct hostapd_data *hapd)
+{
+	struct ubus_admission_req *areq, *tmp;
+	struct ubus_deferred_frame *f, *ftmp;
+	struct ubus_verdict *v, *vtmp;
+
+	list_for_each_entry_safe(areq, tmp, &hapd->ubus.admission_reqs, list) {
+		eloop_cancel_timeout(hostapd_ubus_admission_timeout, areq, NULL);
+		if (ctx)
+			ubus_abort_request(ctx, &areq->nreq.req);
+		list_for_each_entry_safe(f, ftmp, &areq->frames, list)
+			os_free(f);
+		list_del(&areq->list);
+		os_free(areq);
+	}
+	hapd->ubus.n_admission_reqs = 0;
+
+	avl_for_each_element_safe(&hapd->ubus.verdicts, v, avl, vtmp)
+		hostapd_ubus_verdict_free(hapd, v);
+}
+
+static void
+hostapd_ubus_admission_queue(struct ubus_admission_req *areq,
+			     struct hostapd_ubus_request *req)
+{
+	struct ubus_deferred_frame *f;
+
+	if (areq->n_frames >= ADMISSION_MAX_FRAMES) {
+		/* keep the most recent ones, the station retries anyway */
+		f = list_first_entry(&areq->frames, struct ubus_deferred_frame, list);
+		list_del(&f->list);
+		os_free(f);
+		areq->n_frames--;
+		areq->hapd->ubus.admission_stats.dropped++;
+	}
+
+	f = os_malloc(sizeof(*f) + req->frame_len);
+	if (!f)
+		return;
+
+	os_memset(&f->fi, 0, sizeof(f->fi));
+	f->fi.freq = areq->hapd->iface->freq;
+	f->fi.ssi_signal = req->ssi_signal;
+	f->len = req->frame_len;
+	os_memcpy(f->data, req->mgmt_frame, req->frame_len);
+	list_add_tail(&f->list, &areq->frames);
+	areq->n_frames++;
+}
+
+/*
+ * Ask the subscribers about a frame without blocking the event loop. The
+ * frame is queued and answered once their verdict arrives (or the timeout
+ * hits), repeated requests are answered from the verdict cache.
+ */
+static int
+hostapd_ubus_admission(struct hostapd_data *hapd, struct hostapd_ubus_request *req,
+		       const u8 *addr, const char *type)
+{
+	struct ubus_admission_key key = {};
+	struct ubus_admission_req *areq;
+	struct ubus_verdict *v;
+
+	memcpy(key.addr, addr, ETH_ALEN);
+	key.type = req->type;
+
+	if (admission_replay &&
+	    !memcmp(&admission_replay->key, &key, sizeof(key)))
+		return admission_replay->resp;
+
+	v = hostapd_ubus_verdict_get(hapd, &key);
+	if (v && v->req) {
+		hostapd_ubus_admission_queue(v->req, req);
+		hapd->ubus.admission_stats.deferred++;
+		return HOSTAPD_UBUS_DEFERRED;
+	}
+
+	if (v) {
+		/* subscribers still get to see the frame */
+		hapd->ubus.admission_stats.cache_hit++;
+		ubus_notify(ctx, &hapd->ubus.obj, type, b.head, -1);
+		return v->resp;
+	}
+
+	hapd->ubus.admission_stats.cache_miss++;
+
+	if (hapd->ubus.n_admission_reqs >= ADMISSION_MAX_REQS) {
+		hapd->ubus.admission_stats.dropped++;
+		return HOSTAPD_UBUS_DEFERRED;
+	}
+
+	v = hostapd_ubus_verdict_new(hapd, &key);
+	if (!v) {
+		hapd->ubus.admission_stats.dropped++;
+		return HOSTAPD_UBUS_DEFERRED;
+	}
+
+	areq = os_zalloc(sizeof(*areq));
+	if (!areq)
+		goto drop;
+
+	areq->hapd = hapd;
+	areq->verdict = v;
+	INIT_LIST_HEAD(&areq->frames);
+
+	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &areq->nreq)) {
+		os_free(areq);
+		hostapd_ubus_verdict_free(hapd, v);
+		return WLAN_STATUS_SUCCESS;
+	}
+
+	areq->nreq.status_cb = hostapd_ubus_admission_status_cb;
+	areq->nreq.complete_cb = hostapd_ubus_admission_complete_cb;
+	ubus_complete_request_async(ctx, &areq->nreq.req);
+
+	v->req = areq;
+	list_add_tail(&areq->list, &hapd->ubus.admission_reqs);
+	hapd->ubus.n_admission_reqs++;
+	eloop_register_timeout(0, hapd->ubus.response_timeout * 1000,
+			       hostapd_ubus_admission_timeout, areq, NULL);
+
+	hostapd_ubus_admission_queue(areq, req);
+	hapd->ubus.admission_stats.deferred++;
+
+	return HOSTAPD_UBUS_DEFERRED;
+
+drop:
+	hostapd_ubus_verdict_free(hapd, v);
+	hapd->ubus.admission_stats.dropped++;
+	return HOSTAPD_UBUS_DEFERRED;
+}
+
 int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_request *req)
 {
 	struct ubus_banned_client *ban;
@@ -1834,11 +2345,15 @@ int hostapd_ubus_handle_event(struct hostapd_data *hapd, struct hostapd_ubus_req
 		return WLAN_STATUS_SUCCESS;
 	}
 
+	if (req->mgmt_frame && req->frame_len)
+		return hostapd_ubus_admission(hapd, req, addr, type);
+
+	/* no frame to replay later (driver SME), wait for the verdict */
 	if (ubus_notify_async(ctx, &hapd->ubus.obj, type, b.head, &ureq.nreq))
 		return WLAN_STATUS_SUCCESS;
 
 	ureq.nreq.status_cb = ubus_event_cb;
-	ubus_complete_request(ctx, &ureq.nreq.req, 100);
+	ubus_complete_request(ctx, &ureq.nreq.req, hapd->ubus.response_timeout);
 
 	if (ureq.resp)
 		return ureq.resp;
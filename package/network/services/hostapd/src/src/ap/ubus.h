@@ -18,11 +18,18 @@ enum hostapd_ubus_event_type {
 struct hostapd_ubus_request {
 	enum hostapd_ubus_event_type type;
 	const struct ieee80211_mgmt *mgmt_frame;
+	size_t frame_len;
 	const struct ieee802_11_elems *elems;
 	int ssi_signal; /* dBm */
 	const u8 *addr;
 };
 
+/*
+ * Returned by hostapd_ubus_handle_event() when a copy of the frame was queued
+ * until the subscribers have replied, the caller must drop it without reply.
+ */
+#define HOSTAPD_UBUS_DEFERRED	(-EINPROGRESS)
+
 struct hostapd_iface;
 struct hostapd_data;
 struct hapd_interfaces;
@@ -37,6 +44,21 @@ struct hostapd_ubus_bss {
 	struct ubus_object obj;
 	struct avl_tree banned;
 	int notify_response;
+
+	/* cached subscriber verdicts for probe/auth/assoc requests */
+	struct avl_tree verdicts;
+	struct list_head admission_reqs;
+	int n_admission_reqs;
+	unsigned int verdict_ttl;
+	unsigned int response_timeout;
+
+	struct {
+		u64 cache_hit;
+		u64 cache_miss;
+		u64 deferred;
+		u64 dropped;
+		u64 timeout;
+	} admission_stats;
 };
 
 void hostapd_ubus_add_iface(struct hostapd_iface *iface);
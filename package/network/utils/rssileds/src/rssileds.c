@@ -26,11 +26,24 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <net/if.h>
+
+#include <linux/nl80211.h>
+#include <netlink/genl/genl.h>
+#include <netlink/genl/family.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include <libubox/list.h>
+#include <libubox/uloop.h>
 
 #include "iwinfo.h"
 
@@ -38,8 +51,8 @@
 #define LEDS_BASEPATH		"/sys/class/leds/"
 #define BACKEND_RETRY_DELAY	500000
 
-char *ifname;
-int qual_max;
+/* iwinfo nl80211 quality is the signal in dBm offset by this */
+#define NL80211_QUAL_OFFSET	110
 
 struct led {
 	char *sysfspath;
@@ -158,20 +171,41 @@ void close_led(struct led **led)
 }
 
 
-int quality(const struct iwinfo_ops *iw, const char *ifname)
+struct rssid {
+	struct list_head list;
+	char *ifname;
+	int ifindex;
+	int refresh;
+	int threshold;
+	int qual_max;
+	int q0;
+	int armed;	/* quality the CQM threshold is centered on, -1 if none */
+	int cqm;	/* 1 supported, -1 not supported, 0 not known yet */
+	const struct iwinfo_ops *iw;
+	rule_t *rules;
+	struct uloop_timeout timer;
+};
+
+static LIST_HEAD(rssids);
+
+static struct nl_sock *nl_cmd, *nl_ev;
+static struct nl_cb *nl_ev_cb;
+static int nl80211_id = -1;
+
+int quality(struct rssid *d)
 {
 	int qual;
 
-	if ( ! iw ) return -1;
+	if ( ! d->iw ) return -1;
 
-	if (qual_max < 1)
-		if (iw->quality_max(ifname, &qual_max))
+	if (d->qual_max < 1)
+		if (d->iw->quality_max(d->ifname, &d->qual_max))
 			return -1;
 
-	if (iw->quality(ifname, &qual))
+	if (d->iw->quality(d->ifname, &qual))
 		return -1;
 
-	return ( qual * 100 ) / qual_max ;
+	return ( qual * 100 ) / d->qual_max ;
 }
 
 int open_backend(const struct iwinfo_ops **iw, const char *ifname)
@@ -206,39 +240,346 @@ void update_leds(rule_t *rules, int q)
 	}
 }
 
-int main(int argc, char **argv)
+static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg)
 {
-	int i,q,q0,r,s;
-	const struct iwinfo_ops *iw = NULL;
-	rule_t *headrule = NULL, *currentrule = NULL;
+	int *ret = arg;
+	*ret = err->error;
+	return NL_STOP;
+}
 
-	if (argc < 9 || ( (argc-4) % 5 != 0 ) )
-	{
-		printf("syntax: %s (ifname) (refresh) (threshold) (rule) [rule] ...\n", argv[0]);
-		printf("  rule: (sysfs-name) (minq) (maxq) (offset) (factore)\n");
-		return 1;
+static int finish_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+	*ret = 0;
+	return NL_SKIP;
+}
+
+static int ack_handler(struct nl_msg *msg, void *arg)
+{
+	int *ret = arg;
+	*ret = 0;
+	return NL_STOP;
+}
+
+static int no_seq_check(struct nl_msg *msg, void *arg)
+{
+	return NL_OK;
+}
+
+static int nl_request(struct nl_msg *msg,
+		      int (*handler)(struct nl_msg *, void *), void *arg)
+{
+	struct nl_cb *cb;
+	int err = -ENOMEM;
+
+	cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if ( ! cb )
+		goto free_msg;
+
+	err = nl_send_auto_complete(nl_cmd, msg);
+	if ( err < 0 )
+		goto out;
+
+	err = 1;
+	nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler, &err);
+	if (handler)
+		nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, handler, arg);
+
+	while (err > 0)
+		nl_recvmsgs(nl_cmd, cb);
+
+out:
+	nl_cb_put(cb);
+free_msg:
+	nlmsg_free(msg);
+	return err;
+}
+
+struct mcast_group {
+	const char *name;
+	int id;
+};
+
+static int family_handler(struct nl_msg *msg, void *arg)
+{
+	struct mcast_group *grp = arg;
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[CTRL_ATTR_MAX + 1];
+	struct nlattr *mcgrp;
+	int rem;
+
+	nla_parse(tb, CTRL_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if ( ! tb[CTRL_ATTR_MCAST_GROUPS] )
+		return NL_SKIP;
+
+	nla_for_each_nested(mcgrp, tb[CTRL_ATTR_MCAST_GROUPS], rem) {
+		struct nlattr *tb_grp[CTRL_ATTR_MCAST_GRP_MAX + 1];
+
+		nla_parse(tb_grp, CTRL_ATTR_MCAST_GRP_MAX, nla_data(mcgrp),
+			  nla_len(mcgrp), NULL);
+
+		if ( ! tb_grp[CTRL_ATTR_MCAST_GRP_NAME] ||
+		     ! tb_grp[CTRL_ATTR_MCAST_GRP_ID] )
+			continue;
+
+		if (strcmp(nla_data(tb_grp[CTRL_ATTR_MCAST_GRP_NAME]), grp->name))
+			continue;
+
+		grp->id = nla_get_u32(tb_grp[CTRL_ATTR_MCAST_GRP_ID]);
+	}
+
+	return NL_SKIP;
+}
+
+static int nl80211_subscribe(const char *name)
+{
+	struct mcast_group grp = { .name = name, .id = -1 };
+	struct nl_msg *msg;
+
+	msg = nlmsg_alloc();
+	if ( ! msg )
+		return -1;
+
+	genlmsg_put(msg, 0, 0, genl_ctrl_resolve(nl_cmd, "nlctrl"), 0, 0,
+		    CTRL_CMD_GETFAMILY, 0);
+	nla_put_string(msg, CTRL_ATTR_FAMILY_NAME, "nl80211");
+
+	if (nl_request(msg, family_handler, &grp) || grp.id < 0)
+		return -1;
+
+	return nl_socket_add_membership(nl_ev, grp.id);
+}
+
+/*
+ * Center a single CQM RSSI threshold on the current quality, with the
+ * sustain threshold as hysteresis. The kernel reports once the signal
+ * moved that far from the level of the previous report, so the LEDs
+ * only need to be looked at when a report arrives.
+ */
+static int rssid_set_cqm(struct rssid *d)
+{
+	struct nl_msg *msg;
+	struct nlattr *cqm;
+	int thold, hyst, err;
+
+	if ( nl80211_id < 0 || ! d->ifindex || ! d->iw ||
+	     strcmp(d->iw->name, "nl80211") )
+		return -EOPNOTSUPP;
+
+	thold = d->q0 * d->qual_max / 100 - NL80211_QUAL_OFFSET;
+	hyst = d->threshold * d->qual_max / 100;
+	if ( hyst < 1 )
+		hyst = 1;
+
+	msg = nlmsg_alloc();
+	if ( ! msg )
+		return -ENOMEM;
+
+	genlmsg_put(msg, 0, 0, nl80211_id, 0, 0, NL80211_CMD_SET_CQM, 0);
+	nla_put_u32(msg, NL80211_ATTR_IFINDEX, d->ifindex);
+	cqm = nla_nest_start(msg, NL80211_ATTR_CQM);
+	nla_put_u32(msg, NL80211_ATTR_CQM_RSSI_THOLD, thold);
+	nla_put_u32(msg, NL80211_ATTR_CQM_RSSI_HYST, hyst);
+	nla_nest_end(msg, cqm);
+
+	err = nl_request(msg, NULL, NULL);
+	if ( ! err ) {
+		d->armed = d->q0;
+		return 0;
 	}
 
-	ifname = argv[1];
+	return err < 0 ? err : -EIO;
+}
+
+static void rssid_update(struct rssid *d)
+{
+	int q, err;
+
+	q = quality(d);
+	if ( q < d->q0 - d->threshold || q > d->q0 + d->threshold ) {
+		update_leds(d->rules, q);
+		d->q0 = q;
+	}
+
+	if ( q == -1 && d->q0 == -1 ) {
+		/* re-open backend... */
+		d->ifindex = if_nametoindex(d->ifname);
+		if ( d->cqm > 0 && d->ifindex )
+			return;	/* not associated, wait for connect */
+
+		open_backend(&d->iw, d->ifname);
+		uloop_timeout_set(&d->timer, BACKEND_RETRY_DELAY / 1000);
+		return;
+	}
+
+	if ( q >= 0 && d->cqm >= 0 && d->armed != d->q0 ) {
+		err = rssid_set_cqm(d);
+		if ( ! err ) {
+			if ( d->cqm == 0 )
+				syslog(LOG_INFO, "using CQM RSSI events on %s\n", d->ifname);
+			d->cqm = 1;
+		} else if ( err == -EOPNOTSUPP ) {
+			syslog(LOG_INFO, "no CQM RSSI support on %s, polling\n", d->ifname);
+			d->cqm = -1;
+		}
+	}
+
+	if ( d->cqm > 0 && d->armed >= 0 )
+		return;
+
+	uloop_timeout_set(&d->timer, d->refresh > 1000 ? d->refresh / 1000 : 1);
+}
+
+static void rssid_timer(struct uloop_timeout *t)
+{
+	rssid_update(container_of(t, struct rssid, timer));
+}
+
+static int nl80211_event(struct nl_msg *msg, void *arg)
+{
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	const char *name = NULL;
+	struct rssid *d;
+	int ifindex;
+
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
+
+	if ( ! tb[NL80211_ATTR_IFINDEX] )
+		return NL_SKIP;
+
+	ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+	if ( tb[NL80211_ATTR_IFNAME] )
+		name = nla_get_string(tb[NL80211_ATTR_IFNAME]);
+
+	list_for_each_entry(d, &rssids, list) {
+		switch (gnlh->cmd) {
+		case NL80211_CMD_NEW_INTERFACE:
+			if ( ! name || strcmp(name, d->ifname) )
+				continue;
+			d->ifindex = ifindex;
+			d->cqm = 0;
+			d->armed = -1;
+			break;
+		case NL80211_CMD_DEL_INTERFACE:
+			if ( d->ifindex != ifindex )
+				continue;
+			d->ifindex = 0;
+			d->cqm = 0;
+			d->armed = -1;
+			break;
+		case NL80211_CMD_CONNECT:
+			if ( d->ifindex != ifindex )
+				continue;
+			/* poll until the signal is known, then re-arm */
+			d->cqm = 0;
+			d->armed = -1;
+			break;
+		case NL80211_CMD_DISCONNECT:
+			if ( d->ifindex != ifindex )
+				continue;
+			d->armed = -1;
+			break;
+		case NL80211_CMD_NOTIFY_CQM:
+			if ( d->ifindex != ifindex )
+				continue;
+			break;
+		default:
+			continue;
+		}
+
+		uloop_timeout_cancel(&d->timer);
+		rssid_update(d);
+	}
+
+	return NL_SKIP;
+}
+
+static void nl80211_event_cb(struct uloop_fd *fd, unsigned int events)
+{
+	struct rssid *d;
+
+	if ( nl_recvmsgs(nl_ev, nl_ev_cb) >= 0 )
+		return;
+
+	/* events may have been lost, look at everything again */
+	list_for_each_entry(d, &rssids, list) {
+		uloop_timeout_cancel(&d->timer);
+		d->armed = -1;
+		rssid_update(d);
+	}
+}
+
+static struct uloop_fd nl_ev_fd = {
+	.cb = nl80211_event_cb,
+};
+
+static int nl80211_init(void)
+{
+	nl_cmd = nl_socket_alloc();
+	nl_ev = nl_socket_alloc();
+	nl_ev_cb = nl_cb_alloc(NL_CB_DEFAULT);
+	if ( ! nl_cmd || ! nl_ev || ! nl_ev_cb )
+		return -1;
+
+	if ( genl_connect(nl_cmd) || genl_connect(nl_ev) )
+		return -1;
+
+	nl80211_id = genl_ctrl_resolve(nl_cmd, "nl80211");
+	if ( nl80211_id < 0 )
+		return -1;
+
+	if ( nl80211_subscribe("mlme") || nl80211_subscribe("config") ) {
+		nl80211_id = -1;
+		return -1;
+	}
+
+	nl_cb_set(nl_ev_cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, no_seq_check, NULL);
+	nl_cb_set(nl_ev_cb, NL_CB_VALID, NL_CB_CUSTOM, nl80211_event, NULL);
+
+	nl_ev_fd.fd = nl_socket_get_fd(nl_ev);
+	uloop_fd_add(&nl_ev_fd, ULOOP_READ);
+
+	return 0;
+}
+
+static struct rssid *rssid_init(int argc, char **argv)
+{
+	struct rssid *d;
+	rule_t *currentrule = NULL;
+	int i;
+
+	d = calloc(sizeof(struct rssid), 1);
+	if ( ! d )
+		return NULL;
+
+	d->ifname = argv[0];
+	d->q0 = -1;
+	d->armed = -1;
+	d->timer.cb = rssid_timer;
 
 	/* refresh interval */
-	if ( sscanf(argv[2], "%d", &r) != 1 )
-		return 1;
+	if ( sscanf(argv[1], "%d", &d->refresh) != 1 )
+		return NULL;
 
 	/* sustain threshold */
-	if ( sscanf(argv[3], "%d", &s) != 1 )
-		return 1;
+	if ( sscanf(argv[2], "%d", &d->threshold) != 1 )
+		return NULL;
 
-	openlog("rssileds", LOG_PID, LOG_DAEMON);
-	syslog(LOG_INFO, "monitoring %s, refresh rate %d, threshold %d\n", ifname, r, s);
+	syslog(LOG_INFO, "monitoring %s, refresh rate %d, threshold %d\n",
+		d->ifname, d->refresh, d->threshold);
 
-	currentrule = headrule;
-	for (i=4; i<argc; i=i+5) {
+	for (i=3; i<argc; i=i+5) {
 		if (! currentrule)
 		{
 			/* first element in the list */
 			currentrule = calloc(sizeof(rule_t),1);
-			headrule = currentrule;
+			d->rules = currentrule;
 		}
 		else
 		{
@@ -247,44 +588,72 @@ int main(int argc, char **argv)
 			currentrule = currentrule->next;
 		}
 
+		if ( ! currentrule )
+			return NULL;
+
 		if ( init_led(&(currentrule->led), argv[i]) )
-			return 1;
-		
+			return NULL;
+
 		if ( sscanf(argv[i+1], "%d", &(currentrule->minq)) != 1 )
-			return 1;
+			return NULL;
 
 		if ( sscanf(argv[i+2], "%d", &(currentrule->maxq)) != 1 )
-			return 1;
-		
+			return NULL;
+
 		if ( sscanf(argv[i+3], "%d", &(currentrule->boffset)) != 1 )
-			return 1;
-		
+			return NULL;
+
 		if ( sscanf(argv[i+4], "%d", &(currentrule->bfactor)) != 1 )
+			return NULL;
+	}
+	log_rules(d->rules);
+
+	list_add_tail(&d->list, &rssids);
+
+	return d;
+}
+
+int main(int argc, char **argv)
+{
+	struct rssid *d;
+	int i, n;
+
+	openlog("rssileds", LOG_PID, LOG_DAEMON);
+
+	/* one (ifname) (refresh) (threshold) (rule)... group per interface */
+	for (i=1; i<argc; i=i+n+1) {
+		for (n=0; i+n<argc && strcmp(argv[i+n], "--"); n++);
+
+		if ( n < 8 || ( (n-3) % 5 != 0 ) )
+			goto usage;
+
+		if ( ! rssid_init(n, &argv[i]) )
 			return 1;
 	}
-	log_rules(headrule);
-
-	q0 = -1;
-	do {
-		q = quality(iw, ifname);
-		if ( q < q0 - s || q > q0 + s ) {
-			update_leds(headrule, q);
-			q0=q;
-		};
-		// re-open backend...
-		if ( q == -1 && q0 == -1 ) {
-			if (iw) {
-				iwinfo_finish();
-				iw=NULL;
-				usleep(BACKEND_RETRY_DELAY);
-			}
-			while (open_backend(&iw, ifname))
-				usleep(BACKEND_RETRY_DELAY);
-		}
-		usleep(r);
-	} while(1);
+
+	if ( list_empty(&rssids) )
+		goto usage;
+
+	uloop_init();
+
+	if ( nl80211_init() )
+		syslog(LOG_WARNING, "nl80211 events unavailable, polling\n");
+
+	list_for_each_entry(d, &rssids, list) {
+		open_backend(&d->iw, d->ifname);
+		d->ifindex = if_nametoindex(d->ifname);
+		rssid_update(d);
+	}
+
+	uloop_run();
+	uloop_done();
 
 	iwinfo_finish();
 
 	return 0;
+
+usage:
+	printf("syntax: %s (ifname) (refresh) (threshold) (rule) [rule] ... [-- (ifname) ...]\n", argv[0]);
+	printf("  rule: (sysfs-name) (minq) (maxq) (offset) (factore)\n");
+	return 1;
 }
@@ -342,6 +342,7 @@ else
     STRIP="$(STRIP)" \
     STRIP_KMOD="$(SCRIPT_DIR)/strip-kmod.sh" \
     PATCHELF="$(STAGING_DIR_HOST)/bin/patchelf" \
+    RSTRIP_CACHE="$(BUILD_DIR_TOOLCHAIN)/rstrip-cache" \
     $(SCRIPT_DIR)/rstrip.sh
 endif
 
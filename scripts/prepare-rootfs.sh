@@ -0,0 +1,187 @@
+#!/usr/bin/env bash
+#
+# Copyright (C) 2024 OpenWrt.org
+#
+# This is free software, licensed under the GNU General Public License v2.
+# See /LICENSE for more information.
+#
+# Run the package postinst scripts of a staged root filesystem and create
+# the /etc/rc.d start/stop links of its init scripts.
+#
+# Postinst scripts that are nothing but the generated default_postinst
+# stub (no postinst-pkg, no Require-User) only enable the init scripts of
+# their package, so those are handled here directly. Init scripts with a
+# plain numeric START/STOP and without their own enable/disable are linked
+# without sourcing rc.common, the remaining ones are passed to rc.common
+# with bounded parallelism. Everything else runs in package order exactly
+# like on the target.
+#
+SELF=${0##*/}
+
+ROOT="$1"; shift
+DISABLED=" $* "
+
+[ -d "$ROOT" ] || {
+	echo "usage: $SELF <rootdir> [disabled service...]" >&2
+	exit 1
+}
+
+JOBS="${PREPARE_ROOTFS_JOBS:-$(nproc 2>/dev/null || echo 1)}"
+BASH="$(command -v bash)"
+INFO=./usr/lib/opkg/info
+
+POSTINST_STUB='#!/bin/sh
+[ "${IPKG_NO_SCRIPT}" = "1" ] && exit 0
+[ -s ${IPKG_INSTROOT}/lib/functions.sh ] || exit 0
+. ${IPKG_INSTROOT}/lib/functions.sh
+default_postinst $0 $@'
+
+cd "$ROOT" || exit 1
+
+# rc.common invocations that could not be handled natively, as
+# "<initscript> <action>" pairs
+queue=()
+
+run_postinst() {
+	local script="$1" ret
+
+	IPKG_INSTROOT="$ROOT" "$BASH" "$script"
+	ret=$?
+	if [ $ret -ne 0 ]; then
+		echo "postinst script $script has failed with exit code $ret" >&2
+		exit 1
+	fi
+}
+
+is_stub_postinst() {
+	local pkg="$1"
+
+	[ "$(cat "$INFO/$pkg.postinst")" = "$POSTINST_STUB" ] || return 1
+	[ -e "$INFO/$pkg.postinst-pkg" ] && return 1
+	grep -q '^Require-User:' "$INFO/$pkg.control" 2>/dev/null && return 1
+
+	return 0
+}
+
+# Print the START/STOP level of an init script. Fails if the variable
+# is computed, set more than once or otherwise not a plain number.
+rc_level() {
+	local script="$1" var="$2" lines
+
+	lines="$(grep -w "$var" "$script" | grep -v '^[[:space:]]*#')"
+	[ -n "$lines" ] || return 0
+	[[ "$lines" == *$'\n'* ]] && return 1
+	[[ "$lines" =~ ^$var=[\"\']?([0-9]+)[\"\']?[[:space:]]*$ ]] || return 1
+
+	echo "${BASH_REMATCH[1]}"
+}
+
+# Mirror enable()/disable() of rc.common for an init script, fails if the
+# script may change their outcome when sourced.
+rc_native() {
+	local script="$1" action="$2" name start stop
+
+	grep -Eq '^[[:space:]]*(function[[:space:]]+)?(enable|disable)[[:space:]]*\(|^(\.|source)[[:space:]]' \
+		"$script" && return 1
+
+	name="${script##*/}"
+
+	case "$action" in
+		enable)
+			start="$(rc_level "$script" START)" || return 1
+			stop="$(rc_level "$script" STOP)" || return 1
+			[ -n "$start" ] && \
+				ln -sf "../init.d/$name" "$ROOT/etc/rc.d/S${start}${name##S[0-9][0-9]}"
+			[ -n "$stop" ] && \
+				ln -sf "../init.d/$name" "$ROOT/etc/rc.d/K${stop}${name##K[0-9][0-9]}"
+		;;
+		disable)
+			rm -f "$ROOT"/etc/rc.d/S??$name
+			rm -f "$ROOT"/etc/rc.d/K??$name
+		;;
+	esac
+
+	return 0
+}
+
+rc_action() {
+	rc_native "$1" "$2" || queue+=("$1" "$2")
+}
+
+rc_flush() {
+	[ ${#queue[@]} -gt 0 ] || return 0
+
+	printf '%s\0' "${queue[@]}" | \
+		IPKG_INSTROOT="$ROOT" xargs -0 -n 2 -P "$JOBS" "$BASH" ./etc/rc.common || true
+	queue=()
+}
+
+stub=()
+custom=()
+first=
+
+for script in $INFO/*.postinst; do
+	[ -f "$script" ] || continue
+	pkg="${script##*/}"
+	pkg="${pkg%.postinst}"
+
+	if is_stub_postinst "$pkg"; then
+		stub+=("$pkg")
+		first="${first:-stub}"
+	else
+		custom+=("$script")
+		first="${first:-custom}"
+	fi
+done
+
+[ "$IPKG_NO_SCRIPT" = "1" ] || [ ! -s ./lib/functions.sh ] && stub=()
+
+if [ -d ./rootfs-overlay ] && [ "$first" = "custom" ]; then
+	# the overlay is applied by whichever postinst gets there first,
+	# keep the original sequence so everything sees the same tree
+	for script in $INFO/*.postinst; do
+		run_postinst "$script"
+	done
+else
+	if [ ${#stub[@]} -gt 0 ] && [ -d ./rootfs-overlay ]; then
+		cp -R ./rootfs-overlay/. ./
+		rm -fR ./rootfs-overlay/
+	fi
+
+	for pkg in "${stub[@]}"; do
+		for i in $(grep -s "^/etc/init.d/" "$INFO/$pkg.list"); do
+			[ -f ".$i" ] && rc_action ".$i" enable
+		done
+	done
+	rc_flush
+
+	# Custom postinsts are deliberately not run in parallel. They go
+	# through default_postinst, which allocates users and groups by
+	# appending to /etc/passwd and /etc/group, and many of them edit
+	# shared files such as /etc/config/* or the opkg status file
+	# without any locking. Running them concurrently would make ids and
+	# file contents depend on scheduling, and the image would no
+	# longer be reproducible.
+	for script in "${custom[@]}"; do
+		run_postinst "$script"
+	done
+fi
+
+for script in ./etc/init.d/*; do
+	grep '#!/bin/sh /etc/rc.common' "$script" >/dev/null || continue
+	name="${script##*/}"
+
+	case "$DISABLED" in
+		*" $name "*)
+			rc_action "$script" disable
+			echo "Disabling $name"
+		;;
+		*)
+			rc_action "$script" enable
+			echo "Enabling $name"
+		;;
+	esac
+done
+rc_flush
+
+exit 0
@@ -1,5 +1,5 @@
 #!/usr/bin/env bash
-# 
+#
 # Copyright (C) 2006 OpenWrt.org
 #
 # This is free software, licensed under the GNU General Public License v2.
@@ -20,14 +20,55 @@ TARGETS=$*
   exit 1
 }
 
-find $TARGETS -type f -a -exec file {} \; | \
-  sed -n -e 's/^\(.*\):.*ELF.*\(executable\|relocatable\|shared object\).*,.*/\1:\2/p' | \
-(
-  IFS=":"
-  while read F S; do
-    echo "$SELF: $F: $S"
+export LC_ALL=C
+
+# Set ELF_TYPE to the object type of a file (executable, shared object
+# or relocatable) by looking at its header, fails for anything else.
+elf_type() {
+	local magic c data lo hi i type
+
+	ELF_TYPE=
+	{
+		IFS= read -r -N 4 magic && [ "$magic" = $'\177ELF' ] || return 1
+		IFS= read -r -d '' -n 1 c || return 1	# EI_CLASS
+		IFS= read -r -d '' -n 1 data || return 1	# EI_DATA
+		for i in 6 7 8 9 10 11 12 13 14 15; do
+			IFS= read -r -d '' -n 1 c || return 1
+		done
+		IFS= read -r -d '' -n 1 lo || return 1
+		IFS= read -r -d '' -n 1 hi || return 1
+	} < "$1" 2>/dev/null
+
+	printf -v lo '%d' "'$lo"
+	printf -v hi '%d' "'$hi"
+	[ "$data" = $'\002' ] && type=$((lo << 8 | hi)) || type=$((hi << 8 | lo))
+
+	case "$type" in
+		1) ELF_TYPE="relocatable" ;;
+		2) ELF_TYPE="executable" ;;
+		3) ELF_TYPE="shared object" ;;
+		*) return 1 ;;
+	esac
+}
+
+rstrip_file() {
+	local S="$1" F="$2" key= b a
+
+	[ -n "$RSTRIP_CACHE" ] && {
+		key="$( { echo "$RSTRIP_KEY:$S"; cat "$F"; } | sha256sum)"
+		key="$RSTRIP_CACHE/${key%% *}"
+		# copy next to the file first, a failed copy must not leave
+		# a truncated file behind for the real strip below
+		[ -f "$key" ] && cp "$key" "$F.rstrip.$$" && \
+		chmod --reference="$F" "$F.rstrip.$$" && \
+		mv -f "$F.rstrip.$$" "$F" && {
+			touch -c "$key"
+			return 0
+		}
+		rm -f "$F.rstrip.$$"
+	}
+
 	[ "${S}" = "relocatable" ] && {
-		[ "${F##*.}" == "o" ] && continue
 		eval "$STRIP_KMOD $F"
 	} || {
 		b=$(stat -c '%a' $F)
@@ -45,6 +86,43 @@ find $TARGETS -type f -a -exec file {} \; | \
 		a=$(stat -c '%a' $F)
 		[ "$a" = "$b" ] || chmod $b $F
 	}
-  done
-  true
-)
+
+	[ -n "$key" ] && cp "$F" "$key.$$" && mv -f "$key.$$" "$key"
+
+	return 0
+}
+
+# Results are cached by input content and everything that affects how a
+# file is stripped: the strip flags, the identity of the tools used and
+# the content of this script and of the kmod strip script.
+[ -n "$RSTRIP_CACHE" ] && {
+	mkdir -p "$RSTRIP_CACHE" || RSTRIP_CACHE=
+	RSTRIP_KEY="$STRIP:$STRIP_KMOD:$PATCHELF:${TOPDIR:+1}:$CROSS:$KEEP_BUILD_ID:$NO_RENAME:$KEEP_SYMBOLS"
+	RSTRIP_KEY="$RSTRIP_KEY:$(stat -L -c '%s:%Y' $(command -v ${STRIP%% *} ${CROSS}objcopy ${CROSS}nm $PATCHELF) 2>/dev/null)"
+	RSTRIP_KEY="$RSTRIP_KEY:$(cat "$0" ${STRIP_KMOD%% *} 2>/dev/null | sha256sum)"
+}
+
+export SELF STRIP STRIP_KMOD PATCHELF TOPDIR RSTRIP_CACHE RSTRIP_KEY
+export -f rstrip_file
+
+queue=()
+while IFS= read -r -d '' F; do
+	elf_type "$F" || continue
+	echo "$SELF: $F: $ELF_TYPE"
+	[ "$ELF_TYPE" = "relocatable" ] && [ "${F##*.}" == "o" ] && continue
+	queue+=("$ELF_TYPE" "$F")
+done < <(find $TARGETS -type f -print0)
+
+[ ${#queue[@]} -gt 0 ] && \
+	printf '%s\0' "${queue[@]}" | \
+	xargs -0 -n 2 -P "${RSTRIP_JOBS:-$(nproc 2>/dev/null || echo 1)}" \
+		bash -c 'rstrip_file "$@"' "$SELF"
+
+# Keep the cache below RSTRIP_CACHE_SIZE KiB (256 MiB by default) by
+# dropping the least recently used entries, hits refresh the mtime.
+[ -n "$RSTRIP_CACHE" ] && \
+	find "$RSTRIP_CACHE" -type f -printf '%T@ %k %p\n' | sort -rn | \
+	awk -v max="${RSTRIP_CACHE_SIZE:-262144}" '{ size += $2 } size > max { print $3 }' | \
+	xargs -r rm -f
+
+true
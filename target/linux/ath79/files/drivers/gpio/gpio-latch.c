@@ -68,6 +68,61 @@ gpio_latch_get(struct gpio_chip *gc, unsigned offset)
 	return ret;
 }
 
+/*
+ * Collect the lines in mask, except for the latch enable line, into an
+ * array so they can be handed to the parent GPIO chips in one go.
+ */
+static int
+gpio_latch_collect(struct gpio_latch_chip *glc, unsigned long *mask,
+		   unsigned int *offsets, struct gpio_desc **descs)
+{
+	unsigned int i;
+	int n = 0;
+
+	for_each_set_bit(i, mask, GPIO_LATCH_LINES) {
+		if (i == glc->le_gpio || !glc->gpios[i])
+			continue;
+
+		offsets[n] = i;
+		descs[n] = glc->gpios[i];
+		n++;
+	}
+
+	return n;
+}
+
+static int
+gpio_latch_get_multiple(struct gpio_chip *gc, unsigned long *mask,
+			unsigned long *bits)
+{
+	struct gpio_latch_chip *glc = to_gpio_latch_chip(gc);
+	struct gpio_desc *descs[GPIO_LATCH_LINES];
+	unsigned int offsets[GPIO_LATCH_LINES];
+	DECLARE_BITMAP(values, GPIO_LATCH_LINES);
+	int i, n, ret = 0;
+
+	n = gpio_latch_collect(glc, mask, offsets, descs);
+
+	gpio_latch_lock(glc, false);
+	if (n)
+		ret = gpiod_get_raw_array_value_cansleep(n, descs, NULL,
+							 values);
+	if (!ret && test_bit(glc->le_gpio, mask))
+		ret = gpiod_get_raw_value_cansleep(glc->gpios[glc->le_gpio]);
+	gpio_latch_unlock(glc, false);
+
+	if (ret < 0)
+		return ret;
+
+	if (test_bit(glc->le_gpio, mask))
+		__assign_bit(glc->le_gpio, bits, ret);
+
+	for (i = 0; i < n; i++)
+		__assign_bit(offsets[i], bits, test_bit(i, values));
+
+	return 0;
+}
+
 static void
 gpio_latch_set(struct gpio_chip *gc, unsigned offset, int value)
 {
@@ -85,6 +140,44 @@ gpio_latch_set(struct gpio_chip *gc, unsigned offset, int value)
 	gpio_latch_unlock(glc, disable_latch);
 }
 
+/*
+ * Change all requested lines within a single latch window. The data lines
+ * are written at once and the latch enable line last, so the latch always
+ * takes over the complete new set of values, whether it is being opened
+ * or closed.
+ */
+static void
+gpio_latch_set_multiple(struct gpio_chip *gc, unsigned long *mask,
+			unsigned long *bits)
+{
+	struct gpio_latch_chip *glc = to_gpio_latch_chip(gc);
+	struct gpio_desc *le = glc->gpios[glc->le_gpio];
+	struct gpio_desc *descs[GPIO_LATCH_LINES];
+	unsigned int offsets[GPIO_LATCH_LINES];
+	DECLARE_BITMAP(values, GPIO_LATCH_LINES);
+	bool enable_latch = false;
+	bool disable_latch = false;
+	int le_value = 0;
+	int i, n;
+
+	if (test_bit(glc->le_gpio, mask)) {
+		le_value = test_bit(glc->le_gpio, bits);
+		enable_latch = le_value ^ glc->le_active_low;
+		disable_latch = !enable_latch;
+	}
+
+	n = gpio_latch_collect(glc, mask, offsets, descs);
+	for (i = 0; i < n; i++)
+		__assign_bit(i, values, test_bit(offsets[i], bits));
+
+	gpio_latch_lock(glc, enable_latch);
+	if (n)
+		gpiod_set_raw_array_value_cansleep(n, descs, NULL, values);
+	if (test_bit(glc->le_gpio, mask))
+		gpiod_set_raw_value_cansleep(le, le_value);
+	gpio_latch_unlock(glc, disable_latch);
+}
+
 static int
 gpio_latch_direction_output(struct gpio_chip *gc, unsigned offset, int value)
 {
@@ -156,7 +249,9 @@ static int gpio_latch_probe(struct platform_device *pdev)
 	gc->base = -1;
 	gc->ngpio = GPIO_LATCH_LINES;
 	gc->get = gpio_latch_get;
+	gc->get_multiple = gpio_latch_get_multiple;
 	gc->set = gpio_latch_set;
+	gc->set_multiple = gpio_latch_set_multiple;
 	gc->direction_output = gpio_latch_direction_output;
 	gc->of_node = of_node;
 
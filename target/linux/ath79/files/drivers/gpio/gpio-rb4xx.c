@@ -30,40 +30,46 @@ struct rb4xx_gpio {
 	u16 values;		/* bitfield of GPIO 0-8 current values */
 };
 
-static int rb4xx_gpio_cpld_set(struct rb4xx_gpio *gpio, unsigned int offset,
-			       int value)
+/*
+ * Update the GPIOs in mask to the state in bits. GPIO 0-7 share one CPLD
+ * register, so any number of changes to them costs a single SPI write.
+ */
+static int rb4xx_gpio_cpld_update(struct rb4xx_gpio *gpio, u16 mask, u16 bits)
 {
 	struct rb4xx_cpld *cpld = gpio->cpld;
-	u16 values;
-	int ret;
+	u16 values, changed;
+	int ret = 0;
 
 	mutex_lock(&gpio->lock);
-	values = gpio->values;
+	values = (gpio->values & ~mask) | (bits & mask);
+	changed = values ^ gpio->values;
 
-	if (value)
-		values |= BIT(offset);
-	else
-		values &= ~(BIT(offset));
+	if (changed & 0xff) {
+		ret = cpld->gpio_set_0_7(cpld, values & 0xff);
+		if (unlikely(ret))
+			goto unlock;
 
-	if (values == gpio->values) {
-		ret = 0;
-		goto unlock;
+		gpio->values = (gpio->values & ~0xff) | (values & 0xff);
 	}
 
-	if (offset < 8) {
-		ret = cpld->gpio_set_0_7(cpld, values & 0xff);
-	} else if (offset == 8) {
+	if (changed & BIT(8)) {
 		ret = cpld->gpio_set_8(cpld, values >> 8);
+		if (likely(!ret))
+			gpio->values = values;
 	}
 
-	if(likely(!ret))
-		gpio->values = values;
-
 unlock:
 	mutex_unlock(&gpio->lock);
 	return ret;
 }
 
+static int rb4xx_gpio_cpld_set(struct rb4xx_gpio *gpio, unsigned int offset,
+			       int value)
+{
+	return rb4xx_gpio_cpld_update(gpio, BIT(offset),
+				      value ? BIT(offset) : 0);
+}
+
 static int rb4xx_gpio_get_direction(struct gpio_chip *chip, unsigned int offset)
 {
 	return 0; /* All 9 GPIOs are out */
@@ -93,12 +99,30 @@ static int rb4xx_gpio_get(struct gpio_chip *chip, unsigned int offset)
 	return ret;
 }
 
+static int rb4xx_gpio_get_multiple(struct gpio_chip *chip, unsigned long *mask,
+				   unsigned long *bits)
+{
+	struct rb4xx_gpio *gpio = gpiochip_get_data(chip);
+
+	mutex_lock(&gpio->lock);
+	*bits = (*bits & ~*mask) | (gpio->values & *mask);
+	mutex_unlock(&gpio->lock);
+
+	return 0;
+}
+
 static void rb4xx_gpio_set(struct gpio_chip *chip, unsigned int offset,
 			   int value)
 {
 	rb4xx_gpio_cpld_set(gpiochip_get_data(chip), offset, value);
 }
 
+static void rb4xx_gpio_set_multiple(struct gpio_chip *chip, unsigned long *mask,
+				    unsigned long *bits)
+{
+	rb4xx_gpio_cpld_update(gpiochip_get_data(chip), *mask, *bits);
+}
+
 static int rb4xx_gpio_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -126,7 +150,9 @@ static int rb4xx_gpio_probe(struct platform_device *pdev)
 	gpio->chip.direction_input	= rb4xx_gpio_direction_input;
 	gpio->chip.direction_output	= rb4xx_gpio_direction_output;
 	gpio->chip.get			= rb4xx_gpio_get;
+	gpio->chip.get_multiple		= rb4xx_gpio_get_multiple;
 	gpio->chip.set			= rb4xx_gpio_set;
+	gpio->chip.set_multiple		= rb4xx_gpio_set_multiple;
 	gpio->chip.ngpio		= 9;
 	gpio->chip.base			= -1;
 	gpio->chip.can_sleep		= 1;
@@ -437,7 +437,8 @@ static void ar934x_nfc_send_cmd(struct ar934x_nfc *nfc, unsigned command)
 
 static int ar934x_nfc_do_rw_command(struct ar934x_nfc *nfc, int column,
 				    int page_addr, int len, u32 cmd_reg,
-				    u32 ctrl_reg, bool write)
+				    u32 ctrl_reg, dma_addr_t dma_addr,
+				    bool write)
 {
 	u32 addr0, addr1;
 	u32 dma_ctrl;
@@ -447,7 +448,7 @@ static int ar934x_nfc_do_rw_command(struct ar934x_nfc *nfc, int column,
 
 	WARN_ON(len & 3);
 
-	if (WARN_ON(len > nfc->buf_size))
+	if (WARN_ON(dma_addr == nfc->buf_dma && len > nfc->buf_size))
 		dev_err(nfc->parent, "len=%d > buf_size=%d", len,
 			nfc->buf_size);
 
@@ -476,7 +477,7 @@ retry:
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_INT_STATUS, 0);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_ADDR0_0, addr0);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_ADDR0_1, addr1);
-	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_ADDR, nfc->buf_dma);
+	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_ADDR, dma_addr);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DMA_COUNT, len);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_DATA_SIZE, len);
 	ar934x_nfc_wr(nfc, AR934X_NFC_REG_CTRL, ctrl_reg);
@@ -519,18 +520,19 @@ static int ar934x_nfc_send_readid(struct ar934x_nfc *nfc, unsigned command)
 	cmd_reg |= (command & AR934X_NFC_CMD_CMD0_M) << AR934X_NFC_CMD_CMD0_S;
 
 	err = ar934x_nfc_do_rw_command(nfc, -1, -1, AR934X_NFC_ID_BUF_SIZE,
-				       cmd_reg, nfc->ctrl_reg, false);
+				       cmd_reg, nfc->ctrl_reg, nfc->buf_dma,
+				       false);
 
 	nfc_debug_data("[id] ", nfc->buf, AR934X_NFC_ID_BUF_SIZE);
 
 	return err;
 }
 
-static int ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command,
-				int column, int page_addr, int len)
+static int __ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command,
+				  int column, int page_addr, int len,
+				  dma_addr_t dma_addr)
 {
 	u32 cmd_reg;
-	int err;
 
 	nfc_dbg(nfc, "read, column=%d page=%d len=%d\n",
 		column, page_addr, len);
@@ -544,8 +546,18 @@ static int ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command,
 		cmd_reg |= AR934X_NFC_CMD_SEQ_1C5A1CXR;
 	}
 
-	err = ar934x_nfc_do_rw_command(nfc, column, page_addr, len,
-				       cmd_reg, nfc->ctrl_reg, false);
+	return ar934x_nfc_do_rw_command(nfc, column, page_addr, len,
+					cmd_reg, nfc->ctrl_reg, dma_addr,
+					false);
+}
+
+static int ar934x_nfc_send_read(struct ar934x_nfc *nfc, unsigned command,
+				int column, int page_addr, int len)
+{
+	int err;
+
+	err = __ar934x_nfc_send_read(nfc, command, column, page_addr, len,
+				     nfc->buf_dma);
 
 	nfc_debug_data("[data] ", nfc->buf, len);
 
@@ -589,22 +601,72 @@ static void ar934x_nfc_send_erase(struct ar934x_nfc *nfc, unsigned command,
 	ar934x_nfc_wait_dev_ready(nfc);
 }
 
-static int ar934x_nfc_send_write(struct ar934x_nfc *nfc, unsigned command,
-				 int column, int page_addr, int len)
+static int __ar934x_nfc_send_write(struct ar934x_nfc *nfc, unsigned command,
+				   int column, int page_addr, int len,
+				   dma_addr_t dma_addr)
 {
 	u32 cmd_reg;
 
 	nfc_dbg(nfc, "write, column=%d page=%d len=%d\n",
 		column, page_addr, len);
 
-	nfc_debug_data("[data] ", nfc->buf, len);
-
 	cmd_reg = NAND_CMD_SEQIN << AR934X_NFC_CMD_CMD0_S;
 	cmd_reg |= command << AR934X_NFC_CMD_CMD1_S;
 	cmd_reg |= AR934X_NFC_CMD_SEQ_12;
 
 	return ar934x_nfc_do_rw_command(nfc, column, page_addr, len,
-					cmd_reg, nfc->ctrl_reg, true);
+					cmd_reg, nfc->ctrl_reg, dma_addr,
+					true);
+}
+
+static int ar934x_nfc_send_write(struct ar934x_nfc *nfc, unsigned command,
+				 int column, int page_addr, int len)
+{
+	nfc_debug_data("[data] ", nfc->buf, len);
+
+	return __ar934x_nfc_send_write(nfc, command, column, page_addr, len,
+				       nfc->buf_dma);
+}
+
+/*
+ * Page data can be transferred straight from/to the caller's buffer when
+ * no byte swapping is needed and the buffer is safe for streaming DMA.
+ * The cache line alignment check keeps the invalidate on the non-coherent
+ * MIPS cores from clobbering neighbouring data.
+ */
+static bool ar934x_nfc_can_dma_direct(struct ar934x_nfc *nfc, const u8 *buf)
+{
+	if (nfc->swap_dma)
+		return false;
+
+	return virt_addr_valid(buf) &&
+	       IS_ALIGNED((unsigned long)buf, dma_get_cache_alignment());
+}
+
+static int ar934x_nfc_rw_page_direct(struct ar934x_nfc *nfc, int page,
+				     u8 *buf, bool write)
+{
+	struct mtd_info *mtd = ar934x_nfc_to_mtd(nfc);
+	enum dma_data_direction dir;
+	dma_addr_t dma_addr;
+	int err;
+
+	dir = write ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+
+	dma_addr = dma_map_single(nfc->parent, buf, mtd->writesize, dir);
+	if (dma_mapping_error(nfc->parent, dma_addr))
+		return -ENOMEM;
+
+	if (write)
+		err = __ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page,
+					      mtd->writesize, dma_addr);
+	else
+		err = __ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page,
+					     mtd->writesize, dma_addr);
+
+	dma_unmap_single(nfc->parent, dma_addr, mtd->writesize, dir);
+
+	return err;
 }
 
 static void ar934x_nfc_read_status(struct ar934x_nfc *nfc)
@@ -632,6 +694,12 @@ static void ar934x_nfc_read_status(struct ar934x_nfc *nfc)
 		nfc->buf[0] = status;
 }
 
+/*
+ * The controller only runs the fixed command sequences listed above, so
+ * the driver stays on the legacy interface. None of them issues a bare
+ * command followed by a data phase, which rules out cache reads
+ * (READCACHESEQ/READCACHEEND); every page is a separate READ0/READSTART.
+ */
 static void ar934x_nfc_cmdfunc(struct nand_chip *nand, unsigned int command,
 			       int column, int page_addr)
 {
@@ -895,16 +963,19 @@ static int ar934x_nfc_read_page(struct nand_chip *chip,
 	nfc_dbg(nfc, "read_page: page:%d oob:%d\n", page, oob_required);
 
 	ar934x_nfc_enable_hwecc(nfc);
-	err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page,
-				   mtd->writesize);
+	if (ar934x_nfc_can_dma_direct(nfc, buf)) {
+		err = ar934x_nfc_rw_page_direct(nfc, page, buf, false);
+	} else {
+		err = ar934x_nfc_send_read(nfc, NAND_CMD_READ0, 0, page,
+					   mtd->writesize);
+		if (!err)
+			memcpy(buf, nfc->buf, mtd->writesize);
+	}
 	ar934x_nfc_disable_hwecc(nfc);
 
 	if (err)
 		return err;
 
-	/* TODO: optimize to avoid memcpy */
-	memcpy(buf, nfc->buf, mtd->writesize);
-
 	/* read the ECC status */
 	ecc_ctrl = ar934x_nfc_rr(nfc, AR934X_NFC_REG_ECC_CTRL);
 	ecc_failed = ecc_ctrl & AR934X_NFC_ECC_CTRL_ERR_UNCORRECT;
@@ -992,12 +1063,14 @@ static int ar934x_nfc_write_page(struct nand_chip *chip,
 			return err;
 	}
 
-	/* TODO: optimize to avoid memcopy */
-	memcpy(nfc->buf, buf, mtd->writesize);
-
 	ar934x_nfc_enable_hwecc(nfc);
-	err = ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page,
-				    mtd->writesize);
+	if (ar934x_nfc_can_dma_direct(nfc, buf)) {
+		err = ar934x_nfc_rw_page_direct(nfc, page, (u8 *)buf, true);
+	} else {
+		memcpy(nfc->buf, buf, mtd->writesize);
+		err = ar934x_nfc_send_write(nfc, NAND_CMD_PAGEPROG, 0, page,
+					    mtd->writesize);
+	}
 	ar934x_nfc_disable_hwecc(nfc);
 
 	return err;
@@ -1427,6 +1500,16 @@ static int ar934x_nfc_probe(struct platform_device *pdev)
 	nand->legacy.read_buf = ar934x_nfc_read_buf;
 	nand->ecc.engine_type = NAND_ECC_ENGINE_TYPE_ON_HOST;	/* default */
 	nand->priv = nfc;
+
+	/*
+	 * Let the core bounce vmalloc'ed and unaligned buffers through its
+	 * own page buffer, so page accesses can use the direct DMA path.
+	 * Byte swapped transfers always go through our coherent buffer.
+	 */
+	if (!nfc->swap_dma) {
+		nand->options |= NAND_USES_DMA;
+		nand->buf_align = dma_get_cache_alignment();
+	}
 	platform_set_drvdata(pdev, nfc);
 
 	ret = ar934x_nfc_alloc_buf(nfc, AR934X_NFC_ID_BUF_SIZE);
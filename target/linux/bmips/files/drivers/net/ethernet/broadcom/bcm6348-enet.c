@@ -26,6 +26,7 @@
 #include <linux/platform_device.h>
 #include <linux/reset.h>
 #include <linux/version.h>
+#include <net/page_pool.h>
 
 /* DMA channels */
 #define DMA_CHAN_WIDTH			0x10
@@ -306,7 +307,9 @@ module_platform_driver(bcm6348_iudma_driver);
 /* Default number of descriptor */
 #define ENET_DEF_RX_DESC		64
 #define ENET_DEF_TX_DESC		32
-#define ENET_DEF_CPY_BREAK		128
+
+/* Headroom left in front of received frames for build_skb() */
+#define ENET_RX_HEADROOM		NET_SKB_PAD
 
 /* Maximum burst len for dma (4 bytes unit) */
 #define ENET_DMA_MAXBURST		8
@@ -415,8 +418,6 @@ struct bcm6348_emac {
 	struct reset_control **reset;
 	unsigned int num_resets;
 
-	int copybreak;
-
 	int irq_rx;
 	int irq_tx;
 
@@ -448,11 +449,14 @@ struct bcm6348_emac {
 	/* next dirty rx descriptor to refill */
 	int rx_dirty_desc;
 
-	/* size of allocated rx skbs */
-	unsigned int rx_skb_size;
+	/* size of rx buffers given to hw */
+	unsigned int rx_buf_size;
+
+	/* page pool backing the rx ring, one frame per page */
+	struct page_pool *rx_page_pool;
 
-	/* list of skb given to hw for rx */
-	struct sk_buff **rx_skb;
+	/* list of pages given to hw for rx */
+	struct page **rx_page;
 
 	/* used when rx skb allocation failed, so we defer rx queue
 	 * refill */
@@ -519,28 +523,27 @@ static int bcm6348_emac_refill_rx(struct net_device *ndev)
 	struct bcm6348_iudma *iudma = emac->iudma;
 	struct platform_device *pdev = emac->pdev;
 	struct device *dev = &pdev->dev;
+	unsigned int refilled = 0;
 
 	while (emac->rx_desc_count < emac->rx_ring_size) {
 		struct bcm6348_iudma_desc *desc;
-		struct sk_buff *skb;
-		dma_addr_t p;
+		struct page *page;
 		int desc_idx;
 		u32 len_stat;
 
 		desc_idx = emac->rx_dirty_desc;
 		desc = &emac->rx_desc_cpu[desc_idx];
 
-		if (!emac->rx_skb[desc_idx]) {
-			skb = netdev_alloc_skb(ndev, emac->rx_skb_size);
-			if (!skb)
+		if (!emac->rx_page[desc_idx]) {
+			page = page_pool_dev_alloc_pages(emac->rx_page_pool);
+			if (!page)
 				break;
-			emac->rx_skb[desc_idx] = skb;
-			p = dma_map_single(dev, skb->data, emac->rx_skb_size,
-					   DMA_FROM_DEVICE);
-			desc->address = p;
+			emac->rx_page[desc_idx] = page;
+			desc->address = page_pool_get_dma_addr(page) +
+					ENET_RX_HEADROOM;
 		}
 
-		len_stat = emac->rx_skb_size << DMADESC_LENGTH_SHIFT;
+		len_stat = emac->rx_buf_size << DMADESC_LENGTH_SHIFT;
 		len_stat |= DMADESC_OWNER_MASK;
 		if (emac->rx_dirty_desc == emac->rx_ring_size - 1) {
 			len_stat |= DMADESC_WRAP_MASK;
@@ -552,11 +555,13 @@ static int bcm6348_emac_refill_rx(struct net_device *ndev)
 		desc->len_stat = len_stat;
 
 		emac->rx_desc_count++;
-
-		/* tell dma engine we allocated one buffer */
-		dma_writel(iudma, 1, DMA_BUFALLOC_REG(emac->rx_chan));
+		refilled++;
 	}
 
+	/* tell dma engine how many buffers we allocated */
+	if (refilled)
+		dma_writel(iudma, refilled, DMA_BUFALLOC_REG(emac->rx_chan));
+
 	/* If rx ring is still empty, set a timer to try allocating
 	 * again at a later time. */
 	if (emac->rx_desc_count == 0 && netif_running(ndev)) {
@@ -568,6 +573,23 @@ static int bcm6348_emac_refill_rx(struct net_device *ndev)
 	return 0;
 }
 
+/*
+ * release all pages still owned by the rx ring
+ */
+static void bcm6348_emac_free_rx_pages(struct bcm6348_emac *emac)
+{
+	unsigned int i;
+
+	for (i = 0; i < emac->rx_ring_size; i++) {
+		if (!emac->rx_page[i])
+			continue;
+
+		page_pool_put_full_page(emac->rx_page_pool, emac->rx_page[i],
+					false);
+		emac->rx_page[i] = NULL;
+	}
+}
+
 /*
  * timer callback to defer refill rx queue in case we're OOM
  */
@@ -600,6 +622,7 @@ static int bcm6348_emac_receive_queue(struct net_device *ndev, int budget)
 	do {
 		struct bcm6348_iudma_desc *desc;
 		struct sk_buff *skb;
+		struct page *page;
 		int desc_idx;
 		u32 len_stat;
 		unsigned int len;
@@ -631,34 +654,26 @@ static int bcm6348_emac_receive_queue(struct net_device *ndev, int budget)
 		}
 
 		/* valid packet */
-		skb = emac->rx_skb[desc_idx];
+		page = emac->rx_page[desc_idx];
 		len = (len_stat & DMADESC_LENGTH_MASK)
 		      >> DMADESC_LENGTH_SHIFT;
 		/* don't include FCS */
 		len -= 4;
 
-		if (len < emac->copybreak) {
-			struct sk_buff *nskb;
-
-			nskb = napi_alloc_skb(&emac->napi, len);
-			if (!nskb) {
-				/* forget packet, just rearm desc */
-				ndev->stats.rx_dropped++;
-				continue;
-			}
-
-			dma_sync_single_for_cpu(dev, desc->address,
-						len, DMA_FROM_DEVICE);
-			memcpy(nskb->data, skb->data, len);
-			dma_sync_single_for_device(dev, desc->address,
-						   len, DMA_FROM_DEVICE);
-			skb = nskb;
-		} else {
-			dma_unmap_single(dev, desc->address,
-					 emac->rx_skb_size, DMA_FROM_DEVICE);
-			emac->rx_skb[desc_idx] = NULL;
+		dma_sync_single_for_cpu(dev, desc->address, len,
+					DMA_FROM_DEVICE);
+
+		skb = build_skb(page_address(page), PAGE_SIZE);
+		if (!skb) {
+			/* forget packet, just rearm desc */
+			ndev->stats.rx_dropped++;
+			continue;
 		}
 
+		/* the page now belongs to the skb, refill takes a new one */
+		emac->rx_page[desc_idx] = NULL;
+		skb_mark_for_recycle(skb);
+		skb_reserve(skb, ENET_RX_HEADROOM);
 		skb_put(skb, len);
 		skb->protocol = eth_type_trans(skb, ndev);
 		ndev->stats.rx_packets++;
@@ -685,6 +700,7 @@ static int bcm6348_emac_tx_reclaim(struct net_device *ndev, int force)
 	struct bcm6348_emac *emac = netdev_priv(ndev);
 	struct platform_device *pdev = emac->pdev;
 	struct device *dev = &pdev->dev;
+	unsigned int bytes = 0;
 	int released = 0;
 
 	while (emac->tx_desc_count < emac->tx_ring_size) {
@@ -720,10 +736,13 @@ static int bcm6348_emac_tx_reclaim(struct net_device *ndev, int force)
 		if (desc->len_stat & DMADESC_UNDER_MASK)
 			ndev->stats.tx_errors++;
 
+		bytes += skb->len;
 		dev_kfree_skb(skb);
 		released++;
 	}
 
+	netdev_completed_queue(ndev, released, bytes);
+
 	if (netif_queue_stopped(ndev) && released)
 		netif_wake_queue(ndev);
 
@@ -858,14 +877,16 @@ static netdev_tx_t bcm6348_emac_start_xmit(struct sk_buff *skb,
 	desc->len_stat = len_stat;
 	wmb();
 
-	/* kick tx dma */
-	dmac_writel(iudma, DMAC_CHANCFG_EN_MASK, DMAC_CHANCFG_REG,
-		    emac->tx_chan);
-
 	/* stop queue if no more desc available */
 	if (!emac->tx_desc_count)
 		netif_stop_queue(ndev);
 
+	/* kick tx dma, unless the stack is about to hand us more
+	 * packets and the queue keeps running */
+	if (__netdev_sent_queue(ndev, skb->len, netdev_xmit_more()))
+		dmac_writel(iudma, DMAC_CHANCFG_EN_MASK, DMAC_CHANCFG_REG,
+			    emac->tx_chan);
+
 	ndev->stats.tx_bytes += skb->len;
 	ndev->stats.tx_packets++;
 	ret = NETDEV_TX_OK;
@@ -1073,6 +1094,13 @@ static int bcm6348_emac_open(struct net_device *ndev)
 	struct bcm6348_iudma *iudma = emac->iudma;
 	struct platform_device *pdev = emac->pdev;
 	struct device *dev = &pdev->dev;
+	struct page_pool_params pp_params = {
+		.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV,
+		.order = 0,
+		.nid = NUMA_NO_NODE,
+		.dma_dir = DMA_FROM_DEVICE,
+		.offset = ENET_RX_HEADROOM,
+	};
 	struct sockaddr addr;
 	unsigned int i, size;
 	int ret;
@@ -1148,15 +1176,25 @@ static int bcm6348_emac_open(struct net_device *ndev)
 	emac->tx_curr_desc = 0;
 	spin_lock_init(&emac->tx_lock);
 
-	/* init & fill rx ring with skbs */
-	emac->rx_skb = kzalloc(sizeof(struct sk_buff *) * emac->rx_ring_size,
-			       GFP_KERNEL);
-	if (!emac->rx_skb) {
-		dev_err(dev, "cannot allocate rx skb queue\n");
+	/* init & fill rx ring with pages */
+	emac->rx_page = kzalloc(sizeof(struct page *) * emac->rx_ring_size,
+				GFP_KERNEL);
+	if (!emac->rx_page) {
+		dev_err(dev, "cannot allocate rx page queue\n");
 		ret = -ENOMEM;
 		goto out_free_tx_skb;
 	}
 
+	pp_params.pool_size = emac->rx_ring_size;
+	pp_params.dev = dev;
+	pp_params.max_len = emac->rx_buf_size;
+	emac->rx_page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(emac->rx_page_pool)) {
+		dev_err(dev, "cannot allocate rx page pool\n");
+		ret = PTR_ERR(emac->rx_page_pool);
+		goto out_free_rx_page;
+	}
+
 	emac->rx_desc_count = 0;
 	emac->rx_dirty_desc = 0;
 	emac->rx_curr_desc = 0;
@@ -1241,18 +1279,11 @@ static int bcm6348_emac_open(struct net_device *ndev)
 	return 0;
 
 out:
-	for (i = 0; i < emac->rx_ring_size; i++) {
-		struct bcm6348_iudma_desc *desc;
+	bcm6348_emac_free_rx_pages(emac);
+	page_pool_destroy(emac->rx_page_pool);
 
-		if (!emac->rx_skb[i])
-			continue;
-
-		desc = &emac->rx_desc_cpu[i];
-		dma_unmap_single(dev, desc->address, emac->rx_skb_size,
-				 DMA_FROM_DEVICE);
-		kfree_skb(emac->rx_skb[i]);
-	}
-	kfree(emac->rx_skb);
+out_free_rx_page:
+	kfree(emac->rx_page);
 
 out_free_tx_skb:
 	kfree(emac->tx_skb);
@@ -1284,7 +1315,6 @@ static int bcm6348_emac_stop(struct net_device *ndev)
 	struct bcm6348_emac *emac = netdev_priv(ndev);
 	struct bcm6348_iudma *iudma = emac->iudma;
 	struct device *dev = &emac->pdev->dev;
-	unsigned int i;
 
 	netif_stop_queue(ndev);
 	napi_disable(&emac->napi);
@@ -1305,22 +1335,12 @@ static int bcm6348_emac_stop(struct net_device *ndev)
 	/* force reclaim of all tx buffers */
 	bcm6348_emac_tx_reclaim(ndev, 1);
 
-	/* free the rx skb ring */
-	for (i = 0; i < emac->rx_ring_size; i++) {
-		struct bcm6348_iudma_desc *desc;
-
-		if (!emac->rx_skb[i])
-			continue;
-
-		desc = &emac->rx_desc_cpu[i];
-		dma_unmap_single_attrs(dev, desc->address, emac->rx_skb_size,
-				       DMA_FROM_DEVICE,
-				       DMA_ATTR_SKIP_CPU_SYNC);
-		kfree_skb(emac->rx_skb[i]);
-	}
+	/* free the rx page ring */
+	bcm6348_emac_free_rx_pages(emac);
+	page_pool_destroy(emac->rx_page_pool);
 
 	/* free remaining allocated memory */
-	kfree(emac->rx_skb);
+	kfree(emac->rx_page);
 	kfree(emac->tx_skb);
 	dma_free_coherent(dev, emac->rx_desc_alloc_size, emac->rx_desc_cpu,
 			  emac->rx_desc_dma);
@@ -1560,7 +1580,6 @@ static int bcm6348_emac_probe(struct platform_device *pdev)
 
 	emac->rx_ring_size = ENET_DEF_RX_DESC;
 	emac->tx_ring_size = ENET_DEF_TX_DESC;
-	emac->copybreak = ENET_DEF_CPY_BREAK;
 
 	emac->old_link = 0;
 	emac->old_duplex = -1;
@@ -1575,8 +1594,11 @@ static int bcm6348_emac_probe(struct platform_device *pdev)
 		dev_info(dev, "random mac\n");
 	}
 
-	emac->rx_skb_size = ALIGN(ndev->mtu + ENET_MTU_OVERHEAD,
+	emac->rx_buf_size = ALIGN(ndev->mtu + ENET_MTU_OVERHEAD,
 				  ENET_DMA_MAXBURST * 4);
+	if (SKB_DATA_ALIGN(ENET_RX_HEADROOM + emac->rx_buf_size) +
+	    SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) > PAGE_SIZE)
+		return -EINVAL;
 
 	emac->num_clocks = of_clk_get_parent_count(node);
 	if (emac->num_clocks) {
@@ -29,6 +29,14 @@
 
 #define SWCONFIG_DEVNAME	"switch%d"
 
+#define SWITCH_PORT_STATS_MAX_AGE	(HZ / 10)
+
+struct switch_port_stats_entry {
+	struct switch_port_stats stats;
+	unsigned long updated;
+	bool valid;
+};
+
 #include "swconfig_leds.c"
 
 MODULE_AUTHOR("Felix Fietkau <nbd@nbd.name>");
@@ -1137,9 +1145,18 @@ register_switch(struct switch_dev *dev, struct net_device *netdev)
 			kfree(dev->portbuf);
 			return -ENOMEM;
 		}
+		dev->stats_cache = kcalloc(dev->ports,
+				sizeof(struct switch_port_stats_entry),
+				GFP_KERNEL);
+		if (!dev->stats_cache) {
+			kfree(dev->portmap);
+			kfree(dev->portbuf);
+			return -ENOMEM;
+		}
 	}
 	swconfig_defaults_init(dev);
 	mutex_init(&dev->sw_mutex);
+	mutex_init(&dev->stats_mutex);
 	swconfig_lock();
 	dev->id = ++swdev_id;
 
@@ -1182,6 +1199,7 @@ unregister_switch(struct switch_dev *dev)
 {
 	swconfig_destroy_led_trigger(dev);
 	kfree(dev->portbuf);
+	kfree(dev->stats_cache);
 	mutex_lock(&dev->sw_mutex);
 	swconfig_lock();
 	list_del(&dev->dev_list);
@@ -1227,6 +1245,53 @@ switch_generic_set_link(struct switch_dev *dev, int port,
 }
 EXPORT_SYMBOL_GPL(switch_generic_set_link);
 
+/*
+ * Drivers with link change interrupts call this so that the LED trigger
+ * can refresh immediately instead of waiting for its next poll.
+ * Safe to call from atomic context.
+ */
+void switch_link_changed(struct switch_dev *dev)
+{
+	swconfig_led_link_changed(dev);
+}
+EXPORT_SYMBOL_GPL(switch_link_changed);
+
+/*
+ * Returns the statistics of a port from a snapshot that is at most
+ * SWITCH_PORT_STATS_MAX_AGE old, so that the LED trigger and other
+ * readers polling at the same time only cost one driver access.
+ */
+int
+switch_get_port_stats(struct switch_dev *dev, int port,
+		      struct switch_port_stats *stats)
+{
+	struct switch_port_stats_entry *entry;
+	int ret = 0;
+
+	if (!dev->ops->get_port_stats)
+		return -EOPNOTSUPP;
+
+	if (port < 0 || port >= dev->ports || !dev->stats_cache)
+		return -EINVAL;
+
+	entry = &dev->stats_cache[port];
+
+	mutex_lock(&dev->stats_mutex);
+	if (!entry->valid ||
+	    time_after_eq(jiffies, entry->updated + SWITCH_PORT_STATS_MAX_AGE)) {
+		memset(&entry->stats, 0, sizeof(entry->stats));
+		ret = dev->ops->get_port_stats(dev, port, &entry->stats);
+		entry->valid = !ret;
+		entry->updated = jiffies;
+	}
+	if (!ret)
+		*stats = entry->stats;
+	mutex_unlock(&dev->stats_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(switch_get_port_stats);
+
 static int __init
 swconfig_init(void)
 {
@@ -18,6 +18,8 @@
 #include <linux/workqueue.h>
 
 #define SWCONFIG_LED_TIMER_INTERVAL	(HZ / 10)
+#define SWCONFIG_LED_IDLE_INTERVAL	(HZ)		/* link only */
+#define SWCONFIG_LED_NOTIFY_INTERVAL	(5 * HZ)	/* link only, irq */
 #define SWCONFIG_LED_NUM_PORTS		32
 
 #define SWCONFIG_LED_PORT_SPEED_NA	0x01	/* unknown speed */
@@ -44,7 +46,10 @@ struct switch_led_trigger {
 
 	struct delayed_work sw_led_work;
 	u32 port_mask;
+	u32 traffic_mask;
+	u32 traffic_fresh;
 	u32 port_link;
+	bool link_notify;
 	unsigned long long port_tx_traffic[SWCONFIG_LED_NUM_PORTS];
 	unsigned long long port_rx_traffic[SWCONFIG_LED_NUM_PORTS];
 	u8 link_speed[SWCONFIG_LED_NUM_PORTS];
@@ -72,12 +77,29 @@ swconfig_trig_set_brightness(struct swconfig_trig_data *trig_data,
 	trig_data->prev_brightness = brightness;
 }
 
+/*
+ * Port statistics are only needed for LEDs showing tx/rx activity. When
+ * none does, fall back to a slow link poll, and slower still if the
+ * driver reports link changes through switch_link_changed().
+ */
+static unsigned long
+swconfig_trig_interval(struct switch_led_trigger *sw_trig)
+{
+	if (sw_trig->traffic_mask && sw_trig->swdev->ops->get_port_stats)
+		return SWCONFIG_LED_TIMER_INTERVAL;
+
+	if (sw_trig->link_notify)
+		return SWCONFIG_LED_NOTIFY_INTERVAL;
+
+	return SWCONFIG_LED_IDLE_INTERVAL;
+}
+
 static void
 swconfig_trig_update_port_mask(struct led_trigger *trigger)
 {
 	struct list_head *entry;
 	struct switch_led_trigger *sw_trig;
-	u32 port_mask;
+	u32 port_mask, traffic_mask;
 
 	if (!trigger)
 		return;
@@ -85,6 +107,7 @@ swconfig_trig_update_port_mask(struct led_trigger *trigger)
 	sw_trig = (void *) trigger;
 
 	port_mask = 0;
+	traffic_mask = 0;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0)
 	spin_lock(&trigger->leddev_list_lock);
 #else
@@ -99,6 +122,8 @@ swconfig_trig_update_port_mask(struct led_trigger *trigger)
 		if (trig_data) {
 			read_lock(&trig_data->lock);
 			port_mask |= trig_data->port_mask;
+			if (trig_data->mode & SWCONFIG_LED_MODE_TXRX)
+				traffic_mask |= trig_data->port_mask;
 			read_unlock(&trig_data->lock);
 		}
 	}
@@ -108,11 +133,17 @@ swconfig_trig_update_port_mask(struct led_trigger *trigger)
 	read_unlock(&trigger->leddev_list_lock);
 #endif
 
+	/*
+	 * The counters of ports that were not polled are stale, take a new
+	 * baseline for ports entering the mask instead of blinking on it
+	 */
+	sw_trig->traffic_fresh |= traffic_mask & ~sw_trig->traffic_mask;
 	sw_trig->port_mask = port_mask;
+	sw_trig->traffic_mask = traffic_mask;
 
 	if (port_mask)
-		schedule_delayed_work(&sw_trig->sw_led_work,
-				      SWCONFIG_LED_TIMER_INTERVAL);
+		mod_delayed_work(system_wq, &sw_trig->sw_led_work,
+				 swconfig_trig_interval(sw_trig));
 	else
 		cancel_delayed_work_sync(&sw_trig->sw_led_work);
 }
@@ -243,6 +274,7 @@ static ssize_t swconfig_trig_mode_store(struct device *dev,
 	char copybuf[128];
 	int new_mode = -1;
 	char *p, *token;
+	bool changed;
 
 	/* take a copy since we don't want to trash the inbound buffer when using strsep */
 	strncpy(copybuf, buf, sizeof(copybuf));
@@ -272,9 +304,13 @@ static ssize_t swconfig_trig_mode_store(struct device *dev,
 		return -EINVAL;
 
 	write_lock(&trig_data->lock);
+	changed = (trig_data->mode != (u8)new_mode);
 	trig_data->mode = (u8)new_mode;
 	write_unlock(&trig_data->lock);
 
+	if (changed)
+		swconfig_trig_update_port_mask(led_cdev->trigger);
+
 	return size;
 }
 
@@ -353,7 +389,7 @@ swconfig_trig_deactivate(struct led_classdev *led_cdev)
  */
 static void
 swconfig_trig_led_event(struct switch_led_trigger *sw_trig,
-			struct led_classdev *led_cdev)
+			struct led_classdev *led_cdev, bool resync)
 {
 	struct swconfig_trig_data *trig_data;
 	u32 port_mask;
@@ -407,7 +443,7 @@ swconfig_trig_led_event(struct switch_led_trigger *sw_trig,
 			if (trig_data->prev_brightness != led_base)
 				swconfig_trig_set_brightness(trig_data,
 							     led_base);
-			else if (traffic != trig_data->prev_traffic)
+			else if (!resync && traffic != trig_data->prev_traffic)
 				swconfig_trig_set_brightness(trig_data,
 							     led_blink);
 		} else if (trig_data->prev_brightness != LED_OFF)
@@ -420,7 +456,7 @@ swconfig_trig_led_event(struct switch_led_trigger *sw_trig,
 }
 
 static void
-swconfig_trig_update_leds(struct switch_led_trigger *sw_trig)
+swconfig_trig_update_leds(struct switch_led_trigger *sw_trig, bool resync)
 {
 	struct list_head *entry;
 	struct led_trigger *trigger;
@@ -435,7 +471,7 @@ swconfig_trig_update_leds(struct switch_led_trigger *sw_trig)
 		struct led_classdev *led_cdev;
 
 		led_cdev = list_entry(entry, struct led_classdev, trig_list);
-		swconfig_trig_led_event(sw_trig, led_cdev);
+		swconfig_trig_led_event(sw_trig, led_cdev, resync);
 	}
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0)
 	spin_unlock(&trigger->leddev_list_lock);
@@ -449,14 +485,16 @@ swconfig_led_work_func(struct work_struct *work)
 {
 	struct switch_led_trigger *sw_trig;
 	struct switch_dev *swdev;
-	u32 port_mask;
+	u32 port_mask, traffic_mask, fresh;
 	u32 link;
 	int i;
 
 	sw_trig = container_of(work, struct switch_led_trigger,
 			       sw_led_work.work);
 
+	fresh = xchg(&sw_trig->traffic_fresh, 0);
 	port_mask = sw_trig->port_mask;
+	traffic_mask = sw_trig->traffic_mask;
 	swdev = sw_trig->swdev;
 
 	link = 0;
@@ -498,11 +536,11 @@ swconfig_led_work_func(struct work_struct *work)
 			}
 		}
 
-		if (swdev->ops->get_port_stats) {
+		if ((traffic_mask & port_bit) && swdev->ops->get_port_stats) {
 			struct switch_port_stats port_stats;
 
 			memset(&port_stats, '\0', sizeof(port_stats));
-			swdev->ops->get_port_stats(swdev, i, &port_stats);
+			switch_get_port_stats(swdev, i, &port_stats);
 			sw_trig->port_tx_traffic[i] = port_stats.tx_bytes;
 			sw_trig->port_rx_traffic[i] = port_stats.rx_bytes;
 		}
@@ -510,10 +548,25 @@ swconfig_led_work_func(struct work_struct *work)
 
 	sw_trig->port_link = link;
 
-	swconfig_trig_update_leds(sw_trig);
+	swconfig_trig_update_leds(sw_trig, !!(fresh & traffic_mask));
 
 	schedule_delayed_work(&sw_trig->sw_led_work,
-			      SWCONFIG_LED_TIMER_INTERVAL);
+			      swconfig_trig_interval(sw_trig));
+}
+
+static void
+swconfig_led_link_changed(struct switch_dev *swdev)
+{
+	struct switch_led_trigger *sw_trig;
+
+	sw_trig = swdev->led_trigger;
+	if (!sw_trig)
+		return;
+
+	sw_trig->link_notify = true;
+
+	if (sw_trig->port_mask)
+		mod_delayed_work(system_wq, &sw_trig->sw_led_work, 0);
 }
 
 static int
@@ -568,4 +621,7 @@ swconfig_create_led_trigger(struct switch_dev *swdev) { return 0; }
 
 static inline void
 swconfig_destroy_led_trigger(struct switch_dev *swdev) { }
+
+static inline void
+swconfig_led_link_changed(struct switch_dev *swdev) { }
 #endif /* CONFIG_SWCONFIG_LEDS */
@@ -25,6 +25,7 @@ struct switch_val;
 struct switch_attr;
 struct switch_attrlist;
 struct switch_led_trigger;
+struct switch_port_stats_entry;
 
 int register_switch(struct switch_dev *dev, struct net_device *netdev);
 void unregister_switch(struct switch_dev *dev);
@@ -129,6 +130,9 @@ struct switch_dev {
 	struct switch_portmap *portmap;
 	struct switch_port_link linkbuf;
 
+	struct mutex stats_mutex;
+	struct switch_port_stats_entry *stats_cache;
+
 	char buf[128];
 
 #ifdef CONFIG_SWCONFIG_LEDS
@@ -175,5 +179,8 @@ struct switch_attr {
 
 int switch_generic_set_link(struct switch_dev *dev, int port,
 			    struct switch_port_link *link);
+void switch_link_changed(struct switch_dev *dev);
+int switch_get_port_stats(struct switch_dev *dev, int port,
+			  struct switch_port_stats *stats);
 
 #endif /* _LINUX_SWITCH_H */
@@ -119,6 +119,9 @@ extern ret_t rtl8367c_getAsicRegBits(rtk_uint32 reg, rtk_uint32 bits, rtk_uint32
 extern ret_t rtl8367c_setAsicReg(rtk_uint32 reg, rtk_uint32 value);
 extern ret_t rtl8367c_getAsicReg(rtk_uint32 reg, rtk_uint32 *pValue);
 
+extern ret_t rtl8367c_setAsicRegs(rtk_uint32 reg, rtk_uint32 count, const rtk_uint16 *pValue);
+extern ret_t rtl8367c_clearAsicRegCache(void);
+
 #ifdef __cplusplus
 }
 #endif
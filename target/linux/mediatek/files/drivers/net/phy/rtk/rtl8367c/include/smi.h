@@ -48,6 +48,7 @@
 
 rtk_int32 smi_read(rtk_uint32 mAddrs, rtk_uint32 *rData);
 rtk_int32 smi_write(rtk_uint32 mAddrs, rtk_uint32 rData);
+rtk_int32 smi_write_burst(rtk_uint32 mAddrs, rtk_uint32 count, const rtk_uint16 *rData);
 
 #endif /* __SMI_H__ */
 
@@ -16,6 +16,7 @@
  */
 
 #include <rtl8367c_asicdrv.h>
+#include <string.h>
 
 #if defined(RTK_X86_ASICDRV)
 #include <I2Clib.h>
@@ -38,6 +39,173 @@ extern void setReg(rtk_uint16, rtk_uint16);
 extern rtk_uint16 getReg(rtk_uint16);
 #endif
 
+#if !defined(RTK_X86_ASICDRV) && !defined(CONFIG_RTL8367C_ASICDRV_TEST) && !defined(EMBEDDED_SUPPORT)
+#include <linux/mutex.h>
+
+/*
+ * Register shadow for the SMI access path. Every SMI read or write of a
+ * cacheable register updates the shadow, so the read half of the
+ * read-modify-write helpers can be served from memory.
+ */
+#define RTL8367C_REGCACHE_SIZE              1024
+#define RTL8367C_REGCACHE_IDX(reg)          ((reg) & (RTL8367C_REGCACHE_SIZE - 1))
+
+typedef struct rtl8367c_regcache_s
+{
+    rtk_uint16 reg;
+    rtk_uint16 value;
+    rtk_uint32 valid;
+} rtl8367c_regcache_t;
+
+typedef struct rtl8367c_regrange_s
+{
+    rtk_uint16 start;
+    rtk_uint16 end;
+} rtl8367c_regrange_t;
+
+static rtl8367c_regcache_t rtl8367c_regCache[RTL8367C_REGCACHE_SIZE];
+
+/*
+ * Serializes the SMI access and the shadow update of the cached helpers,
+ * so that a read-modify-write can't leave a stale value in the shadow.
+ */
+static DEFINE_MUTEX(rtl8367c_regCacheLock);
+
+/*
+ * Only configuration registers that nothing but the driver changes are
+ * shadowed. Status, counter, flush and indirect access registers are
+ * left out, as is everything else not listed here.
+ */
+static const rtl8367c_regrange_t rtl8367c_cachedReg[] =
+{
+    { 0x0700,                           RTL8367C_REG_HIGHPRI_INDICATOR - 1 },  /* VLAN, RMA, flooding, trunk, isolation, QoS */
+    { RTL8367C_REG_PORT_DEBUG_INFO_CTRL7 + 1, RTL8367C_REG_PORT_EFID_CTRL2 }, /* QoS, mirror, LUT config */
+    { RTL8367C_REG_LUT_CFG2,            RTL8367C_REG_LUT_CFG2 },
+    { RTL8367C_REG_STORM_BCAST,         RTL8367C_REG_LUT_LRN_UNDER_STATUS - 1 }, /* storm control, OAM, 802.1X */
+    { RTL8367C_REG_LUT_LRN_UNDER_STATUS + 1, 0x0eff },                      /* SVLAN, IPMC groups */
+    { RTL8367C_REG_LED_SYS_CONFIG,      RTL8367C_REG_LED_CONFIGURATION },
+    { RTL8367C_REG_PARA_LED_IO_EN1,     RTL8367C_REG_SERIAL_LED_CTRL },
+};
+
+static rtk_uint32 _rtl8367c_regIsCached(rtk_uint32 reg)
+{
+    rtk_uint32 i;
+
+    for(i = 0; i < sizeof(rtl8367c_cachedReg) / sizeof(rtl8367c_cachedReg[0]); i++)
+    {
+        if(reg >= rtl8367c_cachedReg[i].start && reg <= rtl8367c_cachedReg[i].end)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* The helpers below must be called with rtl8367c_regCacheLock held */
+static void _rtl8367c_regCacheUpdate(rtk_uint32 reg, rtk_uint32 value)
+{
+    rtl8367c_regcache_t *pEntry;
+
+    if(!_rtl8367c_regIsCached(reg))
+        return;
+
+    pEntry = &rtl8367c_regCache[RTL8367C_REGCACHE_IDX(reg)];
+    pEntry->reg = reg;
+    pEntry->value = value;
+    pEntry->valid = TRUE;
+}
+
+static void _rtl8367c_regCacheDrop(rtk_uint32 reg)
+{
+    rtl8367c_regcache_t *pEntry;
+
+    pEntry = &rtl8367c_regCache[RTL8367C_REGCACHE_IDX(reg)];
+    if(pEntry->valid && pEntry->reg == reg)
+        pEntry->valid = FALSE;
+}
+
+static ret_t _rtl8367c_regCacheRead(rtk_uint32 reg, rtk_uint32 *pValue)
+{
+    rtl8367c_regcache_t *pEntry;
+    ret_t retVal;
+
+    pEntry = &rtl8367c_regCache[RTL8367C_REGCACHE_IDX(reg)];
+    if(pEntry->valid && pEntry->reg == reg)
+    {
+        *pValue = pEntry->value;
+        return RT_ERR_OK;
+    }
+
+    retVal = smi_read(reg, pValue);
+    if(retVal != RT_ERR_OK)
+        return RT_ERR_SMI;
+
+    _rtl8367c_regCacheUpdate(reg, *pValue);
+
+    return RT_ERR_OK;
+}
+
+static ret_t _rtl8367c_regCacheWrite(rtk_uint32 reg, rtk_uint32 value)
+{
+    ret_t retVal;
+
+    retVal = smi_write(reg, value);
+    if(retVal != RT_ERR_OK)
+    {
+        _rtl8367c_regCacheDrop(reg);
+        return RT_ERR_SMI;
+    }
+
+    _rtl8367c_regCacheUpdate(reg, value);
+
+    return RT_ERR_OK;
+}
+
+/* Read a register from the ASIC and refresh its shadow */
+static ret_t _rtl8367c_regRead(rtk_uint32 reg, rtk_uint32 *pValue)
+{
+    ret_t retVal;
+
+    mutex_lock(&rtl8367c_regCacheLock);
+    retVal = smi_read(reg, pValue);
+    if(retVal == RT_ERR_OK)
+        _rtl8367c_regCacheUpdate(reg, *pValue);
+    mutex_unlock(&rtl8367c_regCacheLock);
+
+    return (retVal == RT_ERR_OK) ? RT_ERR_OK : RT_ERR_SMI;
+}
+
+static ret_t _rtl8367c_regWrite(rtk_uint32 reg, rtk_uint32 value)
+{
+    ret_t retVal;
+
+    mutex_lock(&rtl8367c_regCacheLock);
+    retVal = _rtl8367c_regCacheWrite(reg, value);
+    mutex_unlock(&rtl8367c_regCacheLock);
+
+    return retVal;
+}
+
+/* Replace the bits in mask with value, *pValue returns the new content */
+static ret_t _rtl8367c_regModify(rtk_uint32 reg, rtk_uint32 mask, rtk_uint32 value, rtk_uint32 *pValue)
+{
+    rtk_uint32 regData = 0;
+    ret_t retVal;
+
+    mutex_lock(&rtl8367c_regCacheLock);
+    retVal = _rtl8367c_regCacheRead(reg, &regData);
+    if(retVal == RT_ERR_OK)
+    {
+        regData = (regData & ~mask) | (value & mask);
+        retVal = _rtl8367c_regCacheWrite(reg, regData);
+    }
+    mutex_unlock(&rtl8367c_regCacheLock);
+
+    *pValue = regData;
+
+    return retVal;
+}
+#endif
+
 /* Function Name:
  *      rtl8367c_setAsicRegBit
  * Description:
@@ -123,20 +291,7 @@ ret_t rtl8367c_setAsicRegBit(rtk_uint32 reg, rtk_uint32 bit, rtk_uint32 value)
     if(bit >= RTL8367C_REGBITLENGTH)
         return RT_ERR_INPUT;
 
-    retVal = smi_read(reg, &regData);
-    if(retVal != RT_ERR_OK)
-        return RT_ERR_SMI;
-
-  #ifdef CONFIG_RTL865X_CLE
-    if(0x8367B == cleDebuggingDisplay)
-        PRINT("R[0x%4.4x]=0x%4.4x\n", reg, regData);
-  #endif
-    if(value)
-        regData = regData | (1 << bit);
-    else
-        regData = regData & (~(1 << bit));
-
-    retVal = smi_write(reg, regData);
+    retVal = _rtl8367c_regModify(reg, 1 << bit, value ? (1 << bit) : 0, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
 
@@ -212,7 +367,7 @@ ret_t rtl8367c_getAsicRegBit(rtk_uint32 reg, rtk_uint32 bit, rtk_uint32 *pValue)
     rtk_uint32 regData;
     ret_t retVal;
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_regRead(reg, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
 
@@ -366,18 +521,7 @@ ret_t rtl8367c_setAsicRegBits(rtk_uint32 reg, rtk_uint32 bits, rtk_uint32 value)
     if(valueShifted > RTL8367C_REGDATAMAX)
         return RT_ERR_INPUT;
 
-    retVal = smi_read(reg, &regData);
-    if(retVal != RT_ERR_OK)
-        return RT_ERR_SMI;
-  #ifdef CONFIG_RTL865X_CLE
-    if(0x8367B == cleDebuggingDisplay)
-        PRINT("R[0x%4.4x]=0x%4.4x\n", reg, regData);
-  #endif
-
-    regData = regData & (~bits);
-    regData = regData | (valueShifted & bits);
-
-    retVal = smi_write(reg, regData);
+    retVal = _rtl8367c_regModify(reg, bits, valueShifted, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
   #ifdef CONFIG_RTL865X_CLE
@@ -492,7 +636,7 @@ ret_t rtl8367c_getAsicRegBits(rtk_uint32 reg, rtk_uint32 bits, rtk_uint32 *pValu
             return RT_ERR_INPUT;
     }
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_regRead(reg, &regData);
     if(retVal != RT_ERR_OK) return RT_ERR_SMI;
 
     *pValue = (regData & bits) >> bitsShift;
@@ -559,7 +703,7 @@ ret_t rtl8367c_setAsicReg(rtk_uint32 reg, rtk_uint32 value)
 #else
     ret_t retVal;
 
-    retVal = smi_write(reg, value);
+    retVal = _rtl8367c_regWrite(reg, value);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
   #ifdef CONFIG_RTL865X_CLE
@@ -622,7 +766,7 @@ ret_t rtl8367c_getAsicReg(rtk_uint32 reg, rtk_uint32 *pValue)
     rtk_uint32 regData;
     ret_t retVal;
 
-    retVal = smi_read(reg, &regData);
+    retVal = _rtl8367c_regRead(reg, &regData);
     if(retVal != RT_ERR_OK)
         return RT_ERR_SMI;
 
@@ -636,4 +780,93 @@ ret_t rtl8367c_getAsicReg(rtk_uint32 reg, rtk_uint32 *pValue)
 
     return RT_ERR_OK;
 }
+/* Function Name:
+ *      rtl8367c_setAsicRegs
+ * Description:
+ *      Set content of consecutive asic registers in one burst
+ * Input:
+ *      reg     - address of the first register
+ *      count   - number of registers
+ *      pValue  - values setting to registers
+ * Output:
+ *      None
+ * Return:
+ *      RT_ERR_OK           - Success
+ *      RT_ERR_SMI          - SMI access error
+ *      RT_ERR_NULL_POINTER - Input parameter is null pointer
+ * Note:
+ *      The SMI bus is held for the whole burst, so table data registers
+ *      go out without other MDIO users interleaving.
+ */
+ret_t rtl8367c_setAsicRegs(rtk_uint32 reg, rtk_uint32 count, const rtk_uint16 *pValue)
+{
+#if defined(RTK_X86_ASICDRV) || defined(CONFIG_RTL8367C_ASICDRV_TEST) || defined(EMBEDDED_SUPPORT)
+    rtk_uint32 i;
+    ret_t retVal;
+
+    if(pValue == NULL)
+        return RT_ERR_NULL_POINTER;
+
+    for(i = 0; i < count; i++)
+    {
+        retVal = rtl8367c_setAsicReg(reg + i, pValue[i]);
+        if(retVal != RT_ERR_OK)
+            return retVal;
+    }
+
+#else
+    rtk_uint32 i;
+    ret_t retVal;
+
+    if(pValue == NULL)
+        return RT_ERR_NULL_POINTER;
+
+    mutex_lock(&rtl8367c_regCacheLock);
+    retVal = smi_write_burst(reg, count, pValue);
+    if(retVal != RT_ERR_OK)
+    {
+        for(i = 0; i < count; i++)
+            _rtl8367c_regCacheDrop(reg + i);
+
+        mutex_unlock(&rtl8367c_regCacheLock);
+        return RT_ERR_SMI;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        _rtl8367c_regCacheUpdate(reg + i, pValue[i]);
+  #ifdef CONFIG_RTL865X_CLE
+        if(0x8367B == cleDebuggingDisplay)
+            PRINT("W[0x%4.4x]=0x%4.4x\n", reg + i, pValue[i]);
+  #endif
+    }
+    mutex_unlock(&rtl8367c_regCacheLock);
+
+#endif
+
+    return RT_ERR_OK;
+}
+/* Function Name:
+ *      rtl8367c_clearAsicRegCache
+ * Description:
+ *      Drop all shadowed register values
+ * Input:
+ *      None
+ * Output:
+ *      None
+ * Return:
+ *      RT_ERR_OK   - Success
+ * Note:
+ *      Must be called whenever the ASIC is reset behind the driver's back.
+ */
+ret_t rtl8367c_clearAsicRegCache(void)
+{
+#if !defined(RTK_X86_ASICDRV) && !defined(CONFIG_RTL8367C_ASICDRV_TEST) && !defined(EMBEDDED_SUPPORT)
+    mutex_lock(&rtl8367c_regCacheLock);
+    memset(rtl8367c_regCache, 0x00, sizeof(rtl8367c_regCache));
+    mutex_unlock(&rtl8367c_regCacheLock);
+#endif
+
+    return RT_ERR_OK;
+}
 
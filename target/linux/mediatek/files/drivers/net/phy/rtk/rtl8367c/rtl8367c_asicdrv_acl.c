@@ -289,10 +289,8 @@ ret_t rtl8367c_getAsicAclUnmatchedPermit(rtk_uint32 port, rtk_uint32* pEnabled)
 ret_t rtl8367c_setAsicAclRule(rtk_uint32 index, rtl8367c_aclrule* pAclRule)
 {
     rtl8367c_aclrulesmi aclRuleSmi;
-    rtk_uint16* tableAddr;
     rtk_uint32 regAddr;
     rtk_uint32  regData;
-    rtk_uint32 i;
     ret_t retVal;
 
     if(index > RTL8367C_ACLRULEMAX)
@@ -335,19 +333,9 @@ ret_t rtl8367c_setAsicAclRule(rtk_uint32 index, rtl8367c_aclrule* pAclRule)
         return retVal;
 
     /* Write Care Bits to ACS_DATA registers */
-     tableAddr = (rtk_uint16*)&aclRuleSmi.care_bits;
-     regAddr = RTL8367C_TABLE_ACCESS_WRDATA_BASE;
-
-    for(i = 0; i < RTL8367C_ACLRULETBLEN; i++)
-    {
-        regData = *tableAddr;
-        retVal = rtl8367c_setAsicReg(regAddr, regData);
-        if(retVal != RT_ERR_OK)
-            return retVal;
-
-        regAddr++;
-        tableAddr++;
-    }
+    retVal = rtl8367c_setAsicRegs(RTL8367C_TABLE_ACCESS_WRDATA_BASE, RTL8367C_ACLRULETBLEN, (rtk_uint16*)&aclRuleSmi.care_bits);
+    if(retVal != RT_ERR_OK)
+        return retVal;
     retVal = rtl8367c_setAsicRegBits(RTL8367C_TABLE_ACCESS_WRDATA_REG(RTL8367C_ACLRULETBLEN), (0x0007 << 1), (aclRuleSmi.care_bits_ext.rule_info >> 1) & 0x0007);
     if(retVal != RT_ERR_OK)
         return retVal;
@@ -373,19 +361,9 @@ ret_t rtl8367c_setAsicAclRule(rtk_uint32 index, rtl8367c_aclrule* pAclRule)
         return retVal;
 
     /* Write Data Bits to ACS_DATA registers */
-     tableAddr = (rtk_uint16*)&aclRuleSmi.data_bits;
-     regAddr = RTL8367C_TABLE_ACCESS_WRDATA_BASE;
-
-    for(i = 0; i < RTL8367C_ACLRULETBLEN; i++)
-    {
-        regData = *tableAddr;
-        retVal = rtl8367c_setAsicReg(regAddr, regData);
-        if(retVal != RT_ERR_OK)
-            return retVal;
-
-        regAddr++;
-        tableAddr++;
-    }
+    retVal = rtl8367c_setAsicRegs(RTL8367C_TABLE_ACCESS_WRDATA_BASE, RTL8367C_ACLRULETBLEN, (rtk_uint16*)&aclRuleSmi.data_bits);
+    if(retVal != RT_ERR_OK)
+        return retVal;
 
     retVal = rtl8367c_setAsicRegBit(RTL8367C_TABLE_ACCESS_WRDATA_REG(RTL8367C_ACLRULETBLEN), 0, aclRuleSmi.valid);
     if(retVal != RT_ERR_OK)
@@ -684,8 +662,6 @@ ret_t rtl8367c_setAsicAclAct(rtk_uint32 index, rtl8367c_acl_act_t* pAclAct)
     rtk_uint16 aclActSmi[RTL8367C_ACL_ACT_TABLE_LEN];
     ret_t retVal;
     rtk_uint32 regAddr, regData;
-    rtk_uint16* tableAddr;
-    rtk_uint32 i;
 
     if(index > RTL8367C_ACLRULEMAX)
         return RT_ERR_OUT_OF_RANGE;
@@ -701,19 +677,9 @@ ret_t rtl8367c_setAsicAclAct(rtk_uint32 index, rtl8367c_acl_act_t* pAclAct)
         return retVal;
 
     /* Write Data Bits to ACS_DATA registers */
-     tableAddr = aclActSmi;
-     regAddr = RTL8367C_TABLE_ACCESS_WRDATA_BASE;
-
-    for(i = 0; i < RTL8367C_ACLACTTBLEN; i++)
-    {
-        regData = *tableAddr;
-        retVal = rtl8367c_setAsicReg(regAddr, regData);
-        if(retVal != RT_ERR_OK)
-            return retVal;
-
-        regAddr++;
-        tableAddr++;
-    }
+    retVal = rtl8367c_setAsicRegs(RTL8367C_TABLE_ACCESS_WRDATA_BASE, RTL8367C_ACLACTTBLEN, aclActSmi);
+    if(retVal != RT_ERR_OK)
+        return retVal;
 
     /* Write ACS_CMD register for care bits*/
     regAddr = RTL8367C_TABLE_ACCESS_CTRL_REG;
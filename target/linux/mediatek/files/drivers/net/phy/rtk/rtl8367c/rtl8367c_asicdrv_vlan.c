@@ -215,8 +215,6 @@ ret_t rtl8367c_getAsicVlanMemberConfig(rtk_uint32 index, rtl8367c_vlanconfiguser
 ret_t rtl8367c_setAsicVlan4kEntry(rtl8367c_user_vlan4kentry *pVlan4kEntry )
 {
     rtk_uint16              vlan_4k_entry[RTL8367C_VLAN_4KTABLE_LEN];
-    rtk_uint32                  page_idx;
-    rtk_uint16                  *tableAddr;
     ret_t                   retVal;
     rtk_uint32                  regData;
 
@@ -242,16 +240,9 @@ ret_t rtl8367c_setAsicVlan4kEntry(rtl8367c_user_vlan4kentry *pVlan4kEntry )
     _rtl8367c_Vlan4kStUser2Smi(pVlan4kEntry, vlan_4k_entry);
 
     /* Prepare Data */
-    tableAddr = vlan_4k_entry;
-    for(page_idx = 0; page_idx < RTL8367C_VLAN_4KTABLE_LEN; page_idx++)
-    {
-        regData = *tableAddr;
-        retVal = rtl8367c_setAsicReg(RTL8367C_TABLE_ACCESS_WRDATA_BASE + page_idx, regData);
-        if(retVal != RT_ERR_OK)
-            return retVal;
-
-        tableAddr++;
-    }
+    retVal = rtl8367c_setAsicRegs(RTL8367C_TABLE_ACCESS_WRDATA_BASE, RTL8367C_VLAN_4KTABLE_LEN, vlan_4k_entry);
+    if(retVal != RT_ERR_OK)
+        return retVal;
 
     /* Write Address (VLAN_ID) */
     regData = pVlan4kEntry->vid;
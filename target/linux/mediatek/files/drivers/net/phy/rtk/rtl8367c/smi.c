@@ -34,13 +34,24 @@
 #if 0
 #define MDC_MDIO_WRITE(preamableLength, phyID, regID, data)
 #define MDC_MDIO_READ(preamableLength, phyID, regID, pData)
+#define MDC_MDIO_BUS_LOCK()
+#define MDC_MDIO_BUS_UNLOCK()
+#define MDC_MDIO_WRITE_LOCKED(preamableLength, phyID, regID, data)
 #else
 #define u32      unsigned int
 extern u32 mii_mgr_read(u32 phy_addr, u32 phy_register, u32 *read_data);
 extern u32 mii_mgr_write(u32 phy_addr, u32 phy_register, u32 write_data);
+extern void mii_mgr_lock(void);
+extern void mii_mgr_unlock(void);
+extern u32 __mii_mgr_write(u32 phy_addr, u32 phy_register, u32 write_data);
 
 #define MDC_MDIO_WRITE(preamableLength, phyID, regID, data) mii_mgr_write(phyID, regID, data)
 #define MDC_MDIO_READ(preamableLength, phyID, regID, pData) mii_mgr_read(phyID, regID, pData)
+
+/* Hold the MDIO bus across a burst of register writes */
+#define MDC_MDIO_BUS_LOCK() mii_mgr_lock()
+#define MDC_MDIO_BUS_UNLOCK() mii_mgr_unlock()
+#define MDC_MDIO_WRITE_LOCKED(preamableLength, phyID, regID, data) __mii_mgr_write(phyID, regID, data)
 #endif
 
 
@@ -442,3 +453,55 @@ rtk_int32 smi_write(rtk_uint32 mAddrs, rtk_uint32 rData)
 #endif /* end of #if defined(MDC_MDIO_OPERATION) */
 }
 
+rtk_int32 smi_write_burst(rtk_uint32 mAddrs, rtk_uint32 count, const rtk_uint16 *rData)
+{
+    rtk_uint32 i;
+#if !defined(MDC_MDIO_OPERATION)
+    rtk_int32 retVal;
+#endif
+
+    if(rData == NULL)
+        return RT_ERR_NULL_POINTER;
+
+    if((mAddrs + count) > 0x10000)
+        return RT_ERR_INPUT;
+
+#if defined(MDC_MDIO_OPERATION)
+
+    /* Lock */
+    rtlglue_drvMutexLock();
+    MDC_MDIO_BUS_LOCK();
+
+    for(i = 0; i < count; i++)
+    {
+        /* Write address control code to register 31 */
+        MDC_MDIO_WRITE_LOCKED(MDC_MDIO_PREAMBLE_LEN, MDC_MDIO_PHY_ID, MDC_MDIO_CTRL0_REG, MDC_MDIO_ADDR_OP);
+
+        /* Write address to register 23 */
+        MDC_MDIO_WRITE_LOCKED(MDC_MDIO_PREAMBLE_LEN, MDC_MDIO_PHY_ID, MDC_MDIO_ADDRESS_REG, mAddrs + i);
+
+        /* Write data to register 24 */
+        MDC_MDIO_WRITE_LOCKED(MDC_MDIO_PREAMBLE_LEN, MDC_MDIO_PHY_ID, MDC_MDIO_DATA_WRITE_REG, rData[i]);
+
+        /* Write data control code to register 21 */
+        MDC_MDIO_WRITE_LOCKED(MDC_MDIO_PREAMBLE_LEN, MDC_MDIO_PHY_ID, MDC_MDIO_CTRL1_REG, MDC_MDIO_WRITE_OP);
+    }
+
+    /* Unlock */
+    MDC_MDIO_BUS_UNLOCK();
+    rtlglue_drvMutexUnlock();
+
+    return RT_ERR_OK;
+
+#else
+
+    for(i = 0; i < count; i++)
+    {
+        retVal = smi_write(mAddrs + i, rData[i]);
+        if(retVal != RT_ERR_OK)
+            return retVal;
+    }
+
+    return RT_ERR_OK;
+#endif
+}
@@ -25,6 +25,7 @@
 #include  "./rtl8367c/include/port.h"
 #include  "./rtl8367c/include/vlan.h"
 #include  "./rtl8367c/include/rtl8367c_asicdrv_port.h"
+#include  "./rtl8367c/include/rtl8367c_asicdrv.h"
 
 struct rtk_gsw {
  	struct device           *dev;
@@ -68,10 +69,33 @@ unsigned int mii_mgr_write(unsigned int phy_addr,unsigned int phy_register,unsig
 	return 0;
 }
 
+/* unlocked variant for register bursts issued under mii_mgr_lock() */
+unsigned int __mii_mgr_write(unsigned int phy_addr,unsigned int phy_register,unsigned int write_data)
+{
+	struct mii_bus *bus =  _gsw->bus;
+
+	bus->write(bus, phy_addr, phy_register, write_data);
+
+	return 0;
+}
+
+void mii_mgr_lock(void)
+{
+	mutex_lock_nested(&_gsw->bus->mdio_lock, MDIO_MUTEX_NESTED);
+}
+
+void mii_mgr_unlock(void)
+{
+	mutex_unlock(&_gsw->bus->mdio_lock);
+}
+
 static int rtl8367s_hw_reset(void)
 {
 	struct rtk_gsw *gsw = _gsw;
 
+	/* register state is about to be lost, drop the shadow copies */
+	rtl8367c_clearAsicRegCache();
+
 	if (gsw->reset_pin < 0)
 		return 0;
 
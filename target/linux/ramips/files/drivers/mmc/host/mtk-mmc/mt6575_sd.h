@@ -929,6 +929,7 @@ struct msdc_host {
 	int                         irq;            /* host interrupt */
 
 	struct delayed_work		card_delaywork;
+	struct work_struct		xfer_work;      /* completes data requests */
 
 	struct completion           cmd_done;
 	struct completion           xfer_done;
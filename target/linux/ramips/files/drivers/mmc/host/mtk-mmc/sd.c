@@ -1137,18 +1137,45 @@ static void msdc_dma_setup(struct msdc_host *host, struct msdc_dma *dma,
 	msdc_dma_config(host, dma);
 }
 
-static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
+/* data->host_cookie flags */
+#define MSDC_PREPARE_FLAG   (1 << 0)   /* sg list is mapped */
+#define MSDC_ASYNC_FLAG     (1 << 1)   /* mapped by pre_req, unmapped by post_req */
+
+static void msdc_prepare_data(struct msdc_host *host, struct mmc_data *data)
+{
+	if (data->host_cookie & MSDC_PREPARE_FLAG)
+		return;
+
+	data->sg_count = dma_map_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+				    mmc_get_dma_dir(data));
+	if (data->sg_count)
+		data->host_cookie |= MSDC_PREPARE_FLAG;
+}
+
+static void msdc_unprepare_data(struct msdc_host *host, struct mmc_data *data)
+{
+	if (data->host_cookie & MSDC_ASYNC_FLAG)
+		return;
+
+	if (data->host_cookie & MSDC_PREPARE_FLAG) {
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     mmc_get_dma_dir(data));
+		data->host_cookie &= ~MSDC_PREPARE_FLAG;
+	}
+}
+
+/* Issue the command of a request and start its data transfer. Returns 1
+ * when DMA is running, msdc_end_request() must then only be called after
+ * msdc_wait_xfer().
+ */
+static int msdc_start_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	__must_hold(&host->lock)
 {
 	struct msdc_host *host = mmc_priv(mmc);
 	struct mmc_command *cmd;
 	struct mmc_data *data;
 	void __iomem *base = host->base;
-	//u32 intsts = 0;
-	int read = 1, send_type = 0;
-
-#define SND_DAT 0
-#define SND_CMD 1
+	int read = 1;
 
 	BUG_ON(mmc == NULL);
 	BUG_ON(mrq == NULL);
@@ -1158,87 +1185,98 @@ static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	cmd  = mrq->cmd;
 	data = mrq->cmd->data;
 
-#if 0 /* --- by chhung */
-	//if(host->id ==1){
-	N_MSG(OPS, "enable clock!");
-	msdc_ungate_clock(host->id);
-	//}
-#endif /* end of --- */
-
 	if (!data) {
-		send_type = SND_CMD;
-		if (msdc_do_command(host, cmd, 1, CMD_TIMEOUT) != 0)
-			goto done;
-	} else {
-		BUG_ON(data->blksz > HOST_MAX_BLKSZ);
-		send_type = SND_DAT;
-
-		data->error = 0;
-		read = data->flags & MMC_DATA_READ ? 1 : 0;
-		host->data = data;
-		host->xfer_size = data->blocks * data->blksz;
-		host->blksz = data->blksz;
-
-		if (read) {
-			if ((host->timeout_ns != data->timeout_ns) ||
-				(host->timeout_clks != data->timeout_clks)) {
-				msdc_set_timeout(host, data->timeout_ns, data->timeout_clks);
-			}
+		msdc_do_command(host, cmd, 1, CMD_TIMEOUT);
+		return 0;
+	}
+
+	BUG_ON(data->blksz > HOST_MAX_BLKSZ);
+
+	data->error = 0;
+	read = data->flags & MMC_DATA_READ ? 1 : 0;
+
+	msdc_prepare_data(host, data);
+	if (!(data->host_cookie & MSDC_PREPARE_FLAG)) {
+		data->error = -ENOMEM;
+		return 0;
+	}
+
+	/* CMD23: the card stops by itself, no CMD12 needed */
+	if (mrq->sbc && msdc_do_command(host, mrq->sbc, 1, CMD_TIMEOUT) != 0)
+		return 0;
+
+	host->data = data;
+	host->xfer_size = data->blocks * data->blksz;
+	host->blksz = data->blksz;
+
+	if (read) {
+		if ((host->timeout_ns != data->timeout_ns) ||
+			(host->timeout_clks != data->timeout_clks)) {
+			msdc_set_timeout(host, data->timeout_ns, data->timeout_clks);
 		}
+	}
 
-		sdr_write32(SDC_BLK_NUM, data->blocks);
-		//msdc_clr_fifo();  /* no need */
+	sdr_write32(SDC_BLK_NUM, data->blocks);
+	//msdc_clr_fifo();  /* no need */
 
-		msdc_dma_on();  /* enable DMA mode first!! */
-		init_completion(&host->xfer_done);
+	msdc_dma_on();  /* enable DMA mode first!! */
+	init_completion(&host->xfer_done);
 
-		/* start the command first*/
-		if (msdc_command_start(host, cmd, 1, CMD_TIMEOUT) != 0)
-			goto done;
+	/* start the command first*/
+	if (msdc_command_start(host, cmd, 1, CMD_TIMEOUT) != 0)
+		return 0;
 
-		data->sg_count = dma_map_sg(mmc_dev(mmc), data->sg,
-					    data->sg_len,
-					    mmc_get_dma_dir(data));
-		msdc_dma_setup(host, &host->dma, data->sg,
-			       data->sg_count);
+	msdc_dma_setup(host, &host->dma, data->sg, data->sg_count);
 
-		/* then wait command done */
-		if (msdc_command_resp(host, cmd, 1, CMD_TIMEOUT) != 0)
-			goto done;
+	/* then wait command done */
+	if (msdc_command_resp(host, cmd, 1, CMD_TIMEOUT) != 0)
+		return 0;
 
-		/* for read, the data coming too fast, then CRC error
-		   start DMA no business with CRC. */
-		//init_completion(&host->xfer_done);
-		msdc_dma_start(host);
+	/* for read, the data coming too fast, then CRC error
+	   start DMA no business with CRC. */
+	//init_completion(&host->xfer_done);
+	msdc_dma_start(host);
 
-		spin_unlock(&host->lock);
-		if (!wait_for_completion_timeout(&host->xfer_done, DAT_TIMEOUT)) {
-			ERR_MSG("XXX CMD<%d> wait xfer_done<%d> timeout!!", cmd->opcode, data->blocks * data->blksz);
-			ERR_MSG("    DMA_SA   = 0x%x", sdr_read32(MSDC_DMA_SA));
-			ERR_MSG("    DMA_CA   = 0x%x", sdr_read32(MSDC_DMA_CA));
-			ERR_MSG("    DMA_CTRL = 0x%x", sdr_read32(MSDC_DMA_CTRL));
-			ERR_MSG("    DMA_CFG  = 0x%x", sdr_read32(MSDC_DMA_CFG));
-			data->error = -ETIMEDOUT;
+	return 1;
+}
 
-			msdc_reset_hw(host);
-			msdc_clr_fifo();
-			msdc_clr_int();
-		}
-		spin_lock(&host->lock);
+static void msdc_wait_xfer(struct msdc_host *host, struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+	void __iomem *base = host->base;
+
+	if (!wait_for_completion_timeout(&host->xfer_done, DAT_TIMEOUT)) {
+		ERR_MSG("XXX CMD<%d> wait xfer_done<%d> timeout!!", mrq->cmd->opcode, data->blocks * data->blksz);
+		ERR_MSG("    DMA_SA   = 0x%x", sdr_read32(MSDC_DMA_SA));
+		ERR_MSG("    DMA_CA   = 0x%x", sdr_read32(MSDC_DMA_CA));
+		ERR_MSG("    DMA_CTRL = 0x%x", sdr_read32(MSDC_DMA_CTRL));
+		ERR_MSG("    DMA_CFG  = 0x%x", sdr_read32(MSDC_DMA_CFG));
+		data->error = -ETIMEDOUT;
+
+		msdc_reset_hw(host);
+		msdc_clr_fifo();
+		msdc_clr_int();
+	}
+}
+
+static int msdc_end_request(struct mmc_host *mmc, struct mmc_request *mrq,
+			    int xfer)
+	__must_hold(&host->lock)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->cmd->data;
+
+	if (xfer) {
 		msdc_dma_stop(host);
 
 		/* Last: stop transfer */
-		if (data->stop) {
-			if (msdc_do_command(host, data->stop, 0, CMD_TIMEOUT) != 0)
-				goto done;
-		}
+		if (data->stop && (!mrq->sbc || data->error))
+			msdc_do_command(host, data->stop, 0, CMD_TIMEOUT);
 	}
 
-done:
 	if (data != NULL) {
 		host->data = NULL;
-		dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
-			     mmc_get_dma_dir(data));
+		msdc_unprepare_data(host, data);
 		host->blksz = 0;
 
 #if 0 // don't stop twice!
@@ -1248,37 +1286,14 @@ done:
 		}
 #endif
 
-		N_MSG(OPS, "CMD<%d> data<%s %s> blksz<%d> block<%d> error<%d>", cmd->opcode, (dma ? "dma" : "pio"),
-			(read ? "read " : "write"), data->blksz, data->blocks, data->error);
+		N_MSG(OPS, "CMD<%d> data<%s %s> blksz<%d> block<%d> error<%d>", mrq->cmd->opcode, (dma ? "dma" : "pio"),
+			(data->flags & MMC_DATA_READ ? "read " : "write"), data->blksz, data->blocks, data->error);
 	}
 
-#if 0 /* --- by chhung */
-#if 1
-	//if(host->id==1) {
-	if (send_type == SND_CMD) {
-		if (cmd->opcode == MMC_SEND_STATUS) {
-			if ((cmd->resp[0] & CARD_READY_FOR_DATA) || (CARD_CURRENT_STATE(cmd->resp[0]) != 7)) {
-				N_MSG(OPS, "disable clock, CMD13 IDLE");
-				msdc_gate_clock(host->id);
-			}
-		} else {
-			N_MSG(OPS, "disable clock, CMD<%d>", cmd->opcode);
-			msdc_gate_clock(host->id);
-		}
-	} else {
-		if (read) {
-			N_MSG(OPS, "disable clock!!! Read CMD<%d>", cmd->opcode);
-			msdc_gate_clock(host->id);
-		}
-	}
-	//}
-#else
-	msdc_gate_clock(host->id);
-#endif
-#endif /* end of --- */
-
 	if (mrq->cmd->error)
 		host->error = 0x001;
+	if (mrq->sbc && mrq->sbc->error)
+		host->error |= 0x001;
 	if (mrq->data && mrq->data->error)
 		host->error |= 0x010;
 	if (mrq->stop && mrq->stop->error)
@@ -1289,6 +1304,22 @@ done:
 	return host->error;
 }
 
+static int msdc_do_request(struct mmc_host *mmc, struct mmc_request *mrq)
+	__must_hold(&host->lock)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	int xfer;
+
+	xfer = msdc_start_request(mmc, mrq);
+	if (xfer) {
+		spin_unlock(&host->lock);
+		msdc_wait_xfer(host, mrq);
+		spin_lock(&host->lock);
+	}
+
+	return msdc_end_request(mmc, mrq, xfer);
+}
+
 static int msdc_app_cmd(struct mmc_host *mmc, struct msdc_host *host)
 {
 	struct mmc_command cmd;
@@ -1651,31 +1682,14 @@ static int msdc_tune_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	return ret;
 }
 
-/* ops.request */
-static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
+/* finish a request, called with host->lock held which is released */
+static void msdc_request_done(struct mmc_host *mmc, struct mmc_request *mrq,
+			      int xfer)
+	__releases(&host->lock)
 {
 	struct msdc_host *host = mmc_priv(mmc);
 
-	//=== for sdio profile ===
-#if 0 /* --- by chhung */
-	u32 old_H32, old_L32, new_H32, new_L32;
-	u32 ticks = 0, opcode = 0, sizes = 0, bRx = 0;
-#endif /* end of --- */
-
-	WARN_ON(host->mrq);
-
-	/* start to process */
-	spin_lock(&host->lock);
-#if 0 /* --- by chhung */
-	if (sdio_pro_enable) {  //=== for sdio profile ===
-		if (mrq->cmd->opcode == 52 || mrq->cmd->opcode == 53)
-			GPT_GetCounter64(&old_L32, &old_H32);
-	}
-#endif /* end of --- */
-
-	host->mrq = mrq;
-
-	if (msdc_do_request(mmc, mrq)) {
+	if (msdc_end_request(mmc, mrq, xfer)) {
 		if (host->hw->flags & MSDC_REMOVABLE && ralink_soc == MT762X_SOC_MT7621AT && mrq->data && mrq->data->error)
 			msdc_tune_request(mmc, mrq);
 	}
@@ -1690,32 +1704,72 @@ static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	}
 
 	host->mrq = NULL;
+	spin_unlock(&host->lock);
 
-#if 0 /* --- by chhung */
-	//=== for sdio profile ===
-	if (sdio_pro_enable) {
-		if (mrq->cmd->opcode == 52 || mrq->cmd->opcode == 53) {
-			GPT_GetCounter64(&new_L32, &new_H32);
-			ticks = msdc_time_calc(old_L32, old_H32, new_L32, new_H32);
-
-			opcode = mrq->cmd->opcode;
-			if (mrq->cmd->data) {
-				sizes = mrq->cmd->data->blocks * mrq->cmd->data->blksz;
-				bRx = mrq->cmd->data->flags & MMC_DATA_READ ? 1 : 0;
-			} else {
-				bRx = mrq->cmd->arg	& 0x80000000 ? 1 : 0;
-			}
+	mmc_request_done(mmc, mrq);
+}
 
-			if (!mrq->cmd->error)
-				msdc_performance(opcode, sizes, bRx, ticks);
-		}
+/* runs while the DMA of host->mrq is in flight */
+static void msdc_xfer_work(struct work_struct *work)
+{
+	struct msdc_host *host = container_of(work, struct msdc_host, xfer_work);
+	struct mmc_request *mrq = host->mrq;
+
+	msdc_wait_xfer(host, mrq);
+
+	spin_lock(&host->lock);
+	msdc_request_done(host->mmc, mrq, 1);
+}
+
+/* ops.request */
+static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+
+	WARN_ON(host->mrq);
+
+	/* start to process */
+	spin_lock(&host->lock);
+
+	host->mrq = mrq;
+
+	/* Return while the data is transferred, so the core can prepare the
+	 * next request in the meantime. msdc_xfer_work() completes it.
+	 */
+	if (msdc_start_request(mmc, mrq)) {
+		spin_unlock(&host->lock);
+		schedule_work(&host->xfer_work);
+		return;
 	}
-#endif /* end of --- */
-	spin_unlock(&host->lock);
 
-	mmc_request_done(mmc, mrq);
+	msdc_request_done(mmc, mrq, 0);
+}
+
+static void msdc_ops_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data)
+		return;
 
-	return;
+	msdc_prepare_data(host, data);
+	data->host_cookie |= MSDC_ASYNC_FLAG;
+}
+
+static void msdc_ops_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			      int err)
+{
+	struct msdc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data)
+		return;
+
+	if (data->host_cookie) {
+		data->host_cookie &= ~MSDC_ASYNC_FLAG;
+		msdc_unprepare_data(host, data);
+	}
 }
 
 /* called by ops.set_ios */
@@ -1875,6 +1929,8 @@ static int msdc_ops_get_cd(struct mmc_host *mmc)
 
 static struct mmc_host_ops mt_msdc_ops = {
 	.request         = msdc_ops_request,
+	.pre_req         = msdc_ops_pre_req,
+	.post_req        = msdc_ops_post_req,
 	.set_ios         = msdc_ops_set_ios,
 	.get_ro          = msdc_ops_get_ro,
 	.get_cd          = msdc_ops_get_cd,
@@ -2244,6 +2300,7 @@ static int msdc_drv_probe(struct platform_device *pdev)
 
 	//TODO: read this as bus-width from dt (via mmc_of_parse)
 	mmc->caps  |= MMC_CAP_4_BIT_DATA;
+	mmc->caps  |= MMC_CAP_CMD23;
 
 	cd_active_low = !of_property_read_bool(pdev->dev.of_node, "mediatek,cd-high");
 
@@ -2305,6 +2362,7 @@ static int msdc_drv_probe(struct platform_device *pdev)
 	msdc_init_gpd_bd(host, &host->dma);
 
 	INIT_DELAYED_WORK(&host->card_delaywork, msdc_tasklet_card);
+	INIT_WORK(&host->xfer_work, msdc_xfer_work);
 	spin_lock_init(&host->lock);
 	msdc_init_hw(host);
 
@@ -2369,6 +2427,7 @@ static int msdc_drv_remove(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, NULL);
 	mmc_remove_host(host->mmc);
+	cancel_work_sync(&host->xfer_work);
 	msdc_deinit_hw(host);
 
 	cancel_delayed_work_sync(&host->card_delaywork);
@@ -11,6 +11,7 @@
 #include <linux/clk.h>
 #include <linux/init.h>
 #include <linux/errno.h>
+#include <linux/dma-mapping.h>
 #include <linux/sizes.h>
 #include <linux/iopoll.h>
 #include <linux/kernel.h>
@@ -30,7 +31,9 @@
 #define   CNFG_AUTO_FMT_EN		BIT(9)
 #define   CNFG_HW_ECC_EN		BIT(8)
 #define   CNFG_BYTE_RW			BIT(6)
+#define   CNFG_DMA_BURST_EN		BIT(2)
 #define   CNFG_READ_MODE		BIT(1)
+#define   CNFG_AHB			BIT(0)
 
 #define NFI_PAGEFMT			0x004
 #define   PAGEFMT_FDM_ECC_S		12
@@ -114,6 +117,10 @@
 #define   SEC_ADDR_S			0
 #define   SEC_ADDR_M			GENMASK(9, 0)
 
+#define NFI_STRADDR			0x080
+
+#define NFI_BYTELEN			0x084
+
 #define NFI_CSEL			0x090
 #define   CSEL_S			0
 #define   CSEL_M			GENMASK(1, 0)
@@ -201,6 +208,7 @@
 #define NFI_RESET_TIMEOUT		1000000
 #define NFI_CORE_TIMEOUT		500000
 #define ECC_ENGINE_TIMEOUT		500000
+#define NFI_DMA_TIMEOUT_MS		500
 
 #define ECC_SECTOR_SIZE			512
 #define ECC_PARITY_BITS			13
@@ -220,6 +228,8 @@ struct mt7621_nfc {
 	void __iomem *ecc_regs;
 
 	u32 spare_per_sector;
+
+	bool use_dma;
 };
 
 static const u16 mt7621_nfi_page_size[] = { SZ_512, SZ_2K, SZ_4K };
@@ -623,6 +633,48 @@ static void mt7621_nfc_write_data_empty(struct mt7621_nfc *nfc, u32 len)
 	}
 }
 
+static bool mt7621_nfc_dma_capable(struct mt7621_nfc *nfc, const u8 *buf,
+				   u32 len)
+{
+	u32 align = max_t(u32, dma_get_cache_alignment(), 4);
+
+	if (!nfc->use_dma || !buf)
+		return false;
+
+	/*
+	 * The AHB master only does word-aligned bursts from lowmem, and the
+	 * MIPS cache maintenance done for non-coherent DMA must not touch
+	 * cache lines shared with anything outside of the buffer.
+	 */
+	return virt_addr_valid(buf) && IS_ALIGNED((uintptr_t)buf, align) &&
+	       IS_ALIGNED(len, align);
+}
+
+static int mt7621_nfc_dma_xfer(struct mt7621_nfc *nfc, dma_addr_t addr,
+			       u32 con, u32 cntr_reg)
+{
+	struct device *dev = nfc->dev;
+	u16 val;
+	int ret;
+
+	nfi_write32(nfc, NFI_STRADDR, addr);
+	nfi_write16(nfc, NFI_CON, con);
+	nfi_write16(nfc, NFI_STRDATA, STR_DATA);
+
+	/*
+	 * The NFI interrupt is not wired up in the device tree, so watch the
+	 * sector counter, but let the CPU sleep while the AHB master moves
+	 * the data.
+	 */
+	ret = readw_poll_timeout(nfc->nfi_regs + cntr_reg, val,
+		((val & SEC_CNTR_M) >> SEC_CNTR_S) >= nfc->nand.ecc.steps,
+		20, NFI_DMA_TIMEOUT_MS * 1000);
+	if (ret)
+		dev_warn(dev, "NFI DMA transfer timed out\n");
+
+	return ret;
+}
+
 static int mt7621_nfc_dev_ready(struct mt7621_nfc *nfc,
 				unsigned int timeout_ms)
 {
@@ -1001,6 +1053,67 @@ static void mt7621_nfc_read_sector_fdm(struct mt7621_nfc *nfc, u32 sect)
 		oobptr[i + 4] = (valm >> (i * 8)) & 0xff;
 }
 
+static int mt7621_nfc_read_page_hwecc_dma(struct nand_chip *nand,
+					  uint8_t *buf, int page)
+{
+	struct mt7621_nfc *nfc = nand_get_controller_data(nand);
+	struct mtd_info *mtd = nand_to_mtd(nand);
+	dma_addr_t addr;
+	u32 decnum;
+	u16 val;
+	int ret, i;
+
+	/* -EAGAIN asks the caller to retry the page through PIO */
+	addr = dma_map_single(nfc->dev, buf, mtd->writesize, DMA_FROM_DEVICE);
+	if (dma_mapping_error(nfc->dev, addr))
+		return -EAGAIN;
+
+	nand_read_page_op(nand, page, 0, NULL, 0);
+
+	nfi_write16(nfc, NFI_CNFG, (CNFG_OP_CUSTOM << CNFG_OP_MODE_S) |
+		    CNFG_READ_MODE | CNFG_AUTO_FMT_EN | CNFG_HW_ECC_EN |
+		    CNFG_AHB | CNFG_DMA_BURST_EN);
+
+	mt7621_ecc_decoder_op(nfc, true);
+
+	ret = mt7621_nfc_dma_xfer(nfc, addr,
+		CON_NFI_BRD | (nand->ecc.steps << CON_NFI_SEC_S),
+		NFI_BYTELEN);
+	if (!ret)
+		ret = readw_poll_timeout_atomic(nfc->nfi_regs + NFI_BYTELEN,
+			val, ((val & SEC_CNTR_M) >> SEC_CNTR_S) >=
+			nand->ecc.steps, 10, NFI_CORE_TIMEOUT);
+
+	for (i = 0; !ret && i < nand->ecc.steps; i++) {
+		ret = mt7621_ecc_decoder_wait_done(nfc, i);
+		if (!ret)
+			mt7621_nfc_read_sector_fdm(nfc, i);
+	}
+
+	decnum = ecc_read32(nfc, ECC_DECENUM);
+
+	mt7621_ecc_decoder_op(nfc, false);
+
+	nfi_write16(nfc, NFI_CON, 0);
+
+	dma_unmap_single(nfc->dev, addr, mtd->writesize, DMA_FROM_DEVICE);
+
+	if (ret)
+		return ret;
+
+	/*
+	 * The error location registers only hold the last decoded sector
+	 * once the DMA has run ahead, so let the PIO path handle any page
+	 * that actually needs correcting.
+	 */
+	for (i = 0; i < nand->ecc.steps; i++) {
+		if ((decnum >> (i << ERRNUM_S)) & ERRNUM_M)
+			return -EAGAIN;
+	}
+
+	return 0;
+}
+
 static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
 				      int oob_required, int page)
 {
@@ -1009,6 +1122,14 @@ static int mt7621_nfc_read_page_hwecc(struct nand_chip *nand, uint8_t *buf,
 	int bitflips = 0, ret = 0;
 	int rc, i;
 
+	if (mt7621_nfc_dma_capable(nfc, buf, mtd->writesize)) {
+		ret = mt7621_nfc_read_page_hwecc_dma(nand, buf, page);
+		if (ret != -EAGAIN)
+			return ret;
+
+		ret = 0;
+	}
+
 	nand_read_page_op(nand, page, 0, NULL, 0);
 
 	nfi_write16(nfc, NFI_CNFG, (CNFG_OP_CUSTOM << CNFG_OP_MODE_S) |
@@ -1135,6 +1256,9 @@ static int mt7621_nfc_write_page_hwecc(struct nand_chip *nand,
 {
 	struct mt7621_nfc *nfc = nand_get_controller_data(nand);
 	struct mtd_info *mtd = nand_to_mtd(nand);
+	bool use_dma = false;
+	dma_addr_t addr = 0;
+	int ret = 0;
 
 	if (mt7621_nfc_check_empty_page(nand, buf)) {
 		/*
@@ -1158,20 +1282,43 @@ static int mt7621_nfc_write_page_hwecc(struct nand_chip *nand,
 
 	mt7621_nfc_write_fdm(nfc);
 
-	nfi_write16(nfc, NFI_CON,
-		    CON_NFI_BWR | (nand->ecc.steps << CON_NFI_SEC_S));
+	if (mt7621_nfc_dma_capable(nfc, buf, mtd->writesize)) {
+		addr = dma_map_single(nfc->dev, (void *)buf, mtd->writesize,
+				      DMA_TO_DEVICE);
+		use_dma = !dma_mapping_error(nfc->dev, addr);
+	}
 
-	if (buf)
-		mt7621_nfc_write_data(nfc, buf, mtd->writesize);
-	else
-		mt7621_nfc_write_data_empty(nfc, mtd->writesize);
+	if (use_dma) {
+		nfi_write16(nfc, NFI_CNFG, nfi_read16(nfc, NFI_CNFG) |
+			    CNFG_AHB | CNFG_DMA_BURST_EN);
 
-	mt7621_nfc_wait_write_completion(nfc, nand);
+		ret = mt7621_nfc_dma_xfer(nfc, addr,
+			CON_NFI_BWR | (nand->ecc.steps << CON_NFI_SEC_S),
+			NFI_ADDRCNTR);
+	} else {
+		nfi_write16(nfc, NFI_CON,
+			    CON_NFI_BWR | (nand->ecc.steps << CON_NFI_SEC_S));
+
+		if (buf)
+			mt7621_nfc_write_data(nfc, buf, mtd->writesize);
+		else
+			mt7621_nfc_write_data_empty(nfc, mtd->writesize);
+	}
+
+	if (!ret)
+		mt7621_nfc_wait_write_completion(nfc, nand);
 
 	mt7621_ecc_encoder_op(nfc, false);
 
 	nfi_write16(nfc, NFI_CON, 0);
 
+	if (use_dma)
+		dma_unmap_single(nfc->dev, addr, mtd->writesize,
+				 DMA_TO_DEVICE);
+
+	if (ret)
+		return ret;
+
 	return nand_prog_page_end_op(nand);
 }
 
@@ -1314,6 +1461,13 @@ static int mt7621_nfc_probe(struct platform_device *pdev)
 		}
 	}
 
+	ret = dma_set_mask_and_coherent(dev, DMA_BIT_MASK(32));
+	if (ret) {
+		dev_warn(dev, "No usable DMA configuration, using PIO\n");
+	} else {
+		nfc->use_dma = true;
+	}
+
 	platform_set_drvdata(pdev, nfc);
 
 	ret = mt7621_nfc_init_chip(nfc);
@@ -775,6 +775,7 @@ static irqreturn_t esw_interrupt(int irq, void *_esw)
 			netif_carrier_on(esw->priv->netdev);
 		else
 			netif_carrier_off(esw->priv->netdev);
+		switch_link_changed(&esw->swdev);
 	}
 
 out:
@@ -25,6 +25,7 @@
 #include <net/genetlink.h>
 #include <linux/switch.h>
 #include <linux/delay.h>
+#include <linux/iopoll.h>
 #include <linux/phy.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
@@ -42,6 +43,11 @@
 #define MT7530_MIN_VID		0
 #define MT7530_NUM_ARL_RECORDS 2048
 #define ARL_LINE_LENGTH		30
+#define MT7530_ARL_PAGE_RECORDS	256
+#define ARL_RECORD_LENGTH	32	/* "vvvv pp xx:xx:xx:xx:xx:xx aaa t\n" */
+#define ARL_TRAILER_LENGTH	16	/* "next nnnn\n" or "end\n" */
+#define MT7530_ARL_POLL_US	10
+#define MT7530_ARL_TIMEOUT_US	20000
 
 #define MT7530_PORT_MIB_TXB_ID	2	/* TxGOC */
 #define MT7530_PORT_MIB_RXB_ID	6	/* RxGOC */
@@ -70,6 +76,10 @@
 #define REG_MAC_ATC_SRCH_END  0x4000U
 #define REG_ATRD_VALID        0xff000000U
 #define REG_ATRD_PORT_MASK    0xff0U
+#define REG_ATRD_AGE_SHIFT    24
+#define REG_ATRD_STATUS_MASK  0xcU
+#define REG_ATRD_STATUS_STATIC 0xcU
+#define REG_TSRA2_VID_MASK    0xfffU
 
 #define REG_ESW_VLAN_VAWD1_IVL_MAC	BIT(30)
 #define REG_ESW_VLAN_VAWD1_VTAG_EN	BIT(28)
@@ -179,6 +189,22 @@ struct mt7530_priv {
 	struct mt7530_vlan_entry	vlan_entries[MT7530_NUM_VLANS];
 	struct mt7530_port_entry	port_entries[MT7530_NUM_PORTS];
 	char arl_buf[MT7530_NUM_ARL_RECORDS * ARL_LINE_LENGTH + 1];
+
+	/* ARL search state, serialized by the swconfig device mutex */
+	u32			arl_pos;	/* hits consumed since START */
+	bool			arl_end;
+	u32			arl_cursor;
+	u16			arl_filter_vid;
+	u8			arl_filter_ports;
+	char arl_page[MT7530_ARL_PAGE_RECORDS * ARL_RECORD_LENGTH +
+		      ARL_TRAILER_LENGTH];
+};
+
+/* raw search result: TSRA1, TSRA2, ATRD */
+struct mt7530_arl_rec {
+	u32	mac1;
+	u32	mac2;
+	u32	atrd;
 };
 
 struct mt7530_mapping {
@@ -775,9 +801,100 @@ static int mt7530_sw_get_mib(struct switch_dev *dev,
 	return 0;
 }
 
-static char *mt7530_print_arl_table_row(u32 atrd,
-					u32 mac1,
-					u32 mac2,
+static void mt7530_arl_reset(struct mt7530_priv *priv)
+{
+	priv->arl_pos = 0;
+	priv->arl_end = false;
+}
+
+/*
+ * Fetch the next hit of the hardware search, issuing START on the first
+ * call after a reset. Returns 1 with @rec filled, 0 once the table is
+ * exhausted or a negative error.
+ */
+static int mt7530_arl_next(struct mt7530_priv *priv, struct mt7530_arl_rec *rec)
+{
+	u32 atc;
+	int ret;
+
+	if (priv->arl_end || priv->arl_pos >= MT7530_NUM_ARL_RECORDS)
+		return 0;
+
+	mt7530_w32(priv, REG_ESW_WT_MAC_ATC,
+		   priv->arl_pos ? REG_MAC_ATC_NEXT : REG_MAC_ATC_START);
+
+	ret = read_poll_timeout(mt7530_r32, atc, !(atc & REG_MAC_ATC_BUSY),
+				MT7530_ARL_POLL_US, MT7530_ARL_TIMEOUT_US,
+				false, priv, REG_ESW_WT_MAC_ATC);
+	if (ret) {
+		pr_warn("%s: ARL search timeout\n", __func__);
+		mt7530_arl_reset(priv);
+		return ret;
+	}
+
+	if (!(atc & REG_MAC_ATC_SRCH_HIT)) {
+		priv->arl_end = true;
+		return 0;
+	}
+
+	rec->atrd = mt7530_r32(priv, REG_ESW_TABLE_ATRD);
+	rec->mac1 = mt7530_r32(priv, REG_ESW_TABLE_TSRA1);
+	rec->mac2 = mt7530_r32(priv, REG_ESW_TABLE_TSRA2);
+
+	priv->arl_pos++;
+	if (atc & REG_MAC_ATC_SRCH_END)
+		priv->arl_end = true;
+
+	return 1;
+}
+
+/* Position the hardware search so that the next hit is number @cursor */
+static int mt7530_arl_seek(struct mt7530_priv *priv, u32 cursor)
+{
+	struct mt7530_arl_rec rec;
+	int ret;
+
+	if (cursor < priv->arl_pos || !priv->arl_pos)
+		mt7530_arl_reset(priv);
+
+	while (priv->arl_pos < cursor) {
+		ret = mt7530_arl_next(priv, &rec);
+		if (ret <= 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static bool mt7530_arl_match(struct mt7530_priv *priv,
+			     const struct mt7530_arl_rec *rec)
+{
+	u8 port_map = (rec->atrd & REG_ATRD_PORT_MASK) >> 4;
+
+	if (!(rec->atrd & REG_ATRD_VALID))
+		return false;
+
+	if (priv->arl_filter_vid &&
+	    (rec->mac2 & REG_TSRA2_VID_MASK) != priv->arl_filter_vid)
+		return false;
+
+	if (priv->arl_filter_ports && !(port_map & priv->arl_filter_ports))
+		return false;
+
+	return true;
+}
+
+static void mt7530_arl_mac(const struct mt7530_arl_rec *rec, u8 *mac)
+{
+	mac[0] = rec->mac1 >> 24;
+	mac[1] = rec->mac1 >> 16;
+	mac[2] = rec->mac1 >> 8;
+	mac[3] = rec->mac1;
+	mac[4] = rec->mac2 >> 24;
+	mac[5] = rec->mac2 >> 16;
+}
+
+static char *mt7530_print_arl_table_row(const struct mt7530_arl_rec *rec,
 					char *buf,
 					size_t *size)
 {
@@ -787,11 +904,8 @@ static char *mt7530_print_arl_table_row(u32 atrd,
 	u8 port_map;
 	u8 mac[ETH_ALEN];
 
-	mac1 = ntohl(mac1);
-	mac2 = ntohl(mac2);
-	port_map = (u8)((atrd & REG_ATRD_PORT_MASK) >> 4);
-	memcpy(mac, &mac1, sizeof(mac1));
-	memcpy(mac + sizeof(mac1), &mac2, sizeof(mac) - sizeof(mac1));
+	port_map = (u8)((rec->atrd & REG_ATRD_PORT_MASK) >> 4);
+	mt7530_arl_mac(rec, mac);
 	for (port = 0, i = 1; port < MT7530_NUM_PORTS; ++port, i <<= 1) {
 		if (port_map & i) {
 			ret = snprintf(buf, *size, "Port %d: MAC %pM\n", port, mac);
@@ -813,12 +927,10 @@ static int mt7530_get_arl_table(struct switch_dev *dev,
 				struct switch_val *val)
 {
 	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+	struct mt7530_arl_rec rec;
 	char *buf = priv->arl_buf;
 	size_t size = sizeof(priv->arl_buf);
-	size_t count = 0;
-	size_t retry_times = 100;
 	int ret;
-	u32 atc;
 
 	ret = snprintf(buf, size, "address resolution table\n");
 	if (ret >= size || ret <= 0) {
@@ -828,40 +940,18 @@ static int mt7530_get_arl_table(struct switch_dev *dev,
 	buf += ret;
 	size = size - ret;
 
-	mt7530_w32(priv, REG_ESW_WT_MAC_ATC, REG_MAC_ATC_START);
-
-	do {
-		atc = mt7530_r32(priv, REG_ESW_WT_MAC_ATC);
-		if (atc & REG_MAC_ATC_SRCH_HIT && !(atc & REG_MAC_ATC_BUSY)) {
-			u32 atrd;
+	mt7530_arl_reset(priv);
 
-			++count;
-			atrd = mt7530_r32(priv, REG_ESW_TABLE_ATRD);
-			if (atrd & REG_ATRD_VALID) {
-				u32 mac1;
-				u32 mac2;
-
-				mac1 = mt7530_r32(priv, REG_ESW_TABLE_TSRA1);
-				mac2 = mt7530_r32(priv, REG_ESW_TABLE_TSRA2);
-
-				if (!(atc & REG_MAC_ATC_SRCH_END))
-					mt7530_w32(priv, REG_ESW_WT_MAC_ATC, REG_MAC_ATC_NEXT);
+	while (mt7530_arl_next(priv, &rec) > 0) {
+		if (!mt7530_arl_match(priv, &rec))
+			continue;
 
-				buf = mt7530_print_arl_table_row(atrd, mac1, mac2, buf, &size);
-				if (!buf) {
-					pr_warn("%s: too many addresses\n", __func__);
-					goto out;
-				}
-			} else if (!(atc & REG_MAC_ATC_SRCH_END)) {
-				mt7530_w32(priv, REG_ESW_WT_MAC_ATC, REG_MAC_ATC_NEXT);
-			}
-		} else {
-			--retry_times;
-			usleep_range(1000, 5000);
+		buf = mt7530_print_arl_table_row(&rec, buf, &size);
+		if (!buf) {
+			pr_warn("%s: too many addresses\n", __func__);
+			goto out;
 		}
-	} while (!(atc & REG_MAC_ATC_SRCH_END) &&
-		 count < MT7530_NUM_ARL_RECORDS &&
-		 retry_times > 0);
+	}
 out:
 	val->value.s = priv->arl_buf;
 	val->len = strlen(priv->arl_buf);
@@ -869,6 +959,139 @@ out:
 	return 0;
 }
 
+/*
+ * Return up to MT7530_ARL_PAGE_RECORDS entries starting at arl_cursor, one
+ * fixed width record per line: VID, hex port map, MAC, age and 's'tatic or
+ * 'd'ynamic. The last line is "next <cursor>" or "end". Reading a page
+ * advances arl_cursor, so consecutive reads continue the same hardware
+ * search without restarting it.
+ */
+static int mt7530_get_arl_page(struct switch_dev *dev,
+			       const struct switch_attr *attr,
+			       struct switch_val *val)
+{
+	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+	struct mt7530_arl_rec rec;
+	char *buf = priv->arl_page;
+	size_t size = sizeof(priv->arl_page);
+	int count = 0;
+	int len = 0;
+	int ret;
+
+	ret = mt7530_arl_seek(priv, priv->arl_cursor);
+	if (ret < 0)
+		return ret;
+
+	while (count < MT7530_ARL_PAGE_RECORDS) {
+		u8 mac[ETH_ALEN];
+
+		ret = mt7530_arl_next(priv, &rec);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			break;
+
+		if (!mt7530_arl_match(priv, &rec))
+			continue;
+
+		mt7530_arl_mac(&rec, mac);
+		len += scnprintf(buf + len, size - len, "%4u %02x %pM %3u %c\n",
+				 rec.mac2 & REG_TSRA2_VID_MASK,
+				 (rec.atrd & REG_ATRD_PORT_MASK) >> 4, mac,
+				 rec.atrd >> REG_ATRD_AGE_SHIFT,
+				 (rec.atrd & REG_ATRD_STATUS_MASK) ==
+				 REG_ATRD_STATUS_STATIC ? 's' : 'd');
+		count++;
+	}
+
+	priv->arl_cursor = priv->arl_pos;
+	if (priv->arl_end || priv->arl_pos >= MT7530_NUM_ARL_RECORDS)
+		len += scnprintf(buf + len, size - len, "end\n");
+	else
+		len += scnprintf(buf + len, size - len, "next %u\n",
+				 priv->arl_cursor);
+
+	val->value.s = buf;
+	val->len = len;
+
+	return 0;
+}
+
+static int mt7530_get_arl_cursor(struct switch_dev *dev,
+				 const struct switch_attr *attr,
+				 struct switch_val *val)
+{
+	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+
+	val->value.i = priv->arl_cursor;
+
+	return 0;
+}
+
+static int mt7530_set_arl_cursor(struct switch_dev *dev,
+				 const struct switch_attr *attr,
+				 struct switch_val *val)
+{
+	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+
+	if (val->value.i < 0 || val->value.i > MT7530_NUM_ARL_RECORDS)
+		return -EINVAL;
+
+	priv->arl_cursor = val->value.i;
+
+	return 0;
+}
+
+static int mt7530_get_arl_vid(struct switch_dev *dev,
+			      const struct switch_attr *attr,
+			      struct switch_val *val)
+{
+	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+
+	val->value.i = priv->arl_filter_vid;
+
+	return 0;
+}
+
+static int mt7530_set_arl_vid(struct switch_dev *dev,
+			      const struct switch_attr *attr,
+			      struct switch_val *val)
+{
+	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+
+	if (val->value.i < 0 || val->value.i > MT7530_MAX_VID)
+		return -EINVAL;
+
+	priv->arl_filter_vid = val->value.i;
+
+	return 0;
+}
+
+static int mt7530_get_arl_ports(struct switch_dev *dev,
+				const struct switch_attr *attr,
+				struct switch_val *val)
+{
+	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+
+	val->value.i = priv->arl_filter_ports;
+
+	return 0;
+}
+
+static int mt7530_set_arl_ports(struct switch_dev *dev,
+				const struct switch_attr *attr,
+				struct switch_val *val)
+{
+	struct mt7530_priv *priv = container_of(dev, struct mt7530_priv, swdev);
+
+	if (val->value.i < 0 || val->value.i >= BIT(MT7530_NUM_PORTS))
+		return -EINVAL;
+
+	priv->arl_filter_ports = val->value.i;
+
+	return 0;
+}
+
 static int mt7530_sw_get_port_mib(struct switch_dev *dev,
 				  const struct switch_attr *attr,
 				  struct switch_val *val)
@@ -940,6 +1163,33 @@ static const struct switch_attr mt7530_global[] = {
 		.description = "Get ARL table",
 		.set = NULL,
 		.get = mt7530_get_arl_table,
+	}, {
+		.type = SWITCH_TYPE_STRING,
+		.name = "arl_page",
+		.description = "Get next page of the ARL table from arl_cursor",
+		.set = NULL,
+		.get = mt7530_get_arl_page,
+	}, {
+		.type = SWITCH_TYPE_INT,
+		.name = "arl_cursor",
+		.description = "ARL table position for arl_page (0: restart)",
+		.set = mt7530_set_arl_cursor,
+		.get = mt7530_get_arl_cursor,
+		.max = MT7530_NUM_ARL_RECORDS,
+	}, {
+		.type = SWITCH_TYPE_INT,
+		.name = "arl_vid",
+		.description = "Only list ARL entries of this VID (0: any)",
+		.set = mt7530_set_arl_vid,
+		.get = mt7530_get_arl_vid,
+		.max = MT7530_MAX_VID,
+	}, {
+		.type = SWITCH_TYPE_INT,
+		.name = "arl_ports",
+		.description = "Only list ARL entries on these ports (0: any)",
+		.set = mt7530_set_arl_ports,
+		.get = mt7530_get_arl_ports,
+		.max = BIT(MT7530_NUM_PORTS) - 1,
 	},
 };
 
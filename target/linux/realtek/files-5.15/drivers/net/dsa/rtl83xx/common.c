@@ -3,6 +3,9 @@
 #include <linux/of_mdio.h>
 #include <linux/of_platform.h>
 #include <net/arp.h>
+#include <net/ip_fib.h>
+#include <net/ip6_fib.h>
+#include <net/ndisc.h>
 #include <net/nexthop.h>
 #include <net/neighbour.h>
 #include <net/netevent.h>
@@ -529,25 +532,24 @@ int rtl83xx_lag_del(struct dsa_switch *ds, int group, int port)
 	return 0;
 }
 
-// Currently Unused
-// /* Allocate a 64 bit octet counter located in the LOG HW table */
-// static int rtl83xx_octet_cntr_alloc(struct rtl838x_switch_priv *priv)
-// {
-// 	int idx;
+/* Allocate a 64 bit octet counter located in the LOG HW table */
+int rtl83xx_octet_cntr_alloc(struct rtl838x_switch_priv *priv)
+{
+	int idx;
 
-// 	mutex_lock(&priv->reg_mutex);
+	mutex_lock(&priv->reg_mutex);
 
-// 	idx = find_first_zero_bit(priv->octet_cntr_use_bm, MAX_COUNTERS);
-// 	if (idx >= priv->n_counters) {
-// 		mutex_unlock(&priv->reg_mutex);
-// 		return -1;
-// 	}
+	idx = find_first_zero_bit(priv->octet_cntr_use_bm, MAX_COUNTERS);
+	if (idx >= priv->n_counters) {
+		mutex_unlock(&priv->reg_mutex);
+		return -1;
+	}
 
-// 	set_bit(idx, priv->octet_cntr_use_bm);
-// 	mutex_unlock(&priv->reg_mutex);
+	set_bit(idx, priv->octet_cntr_use_bm);
+	mutex_unlock(&priv->reg_mutex);
 
-// 	return idx;
-// }
+	return idx;
+}
 
 /* Allocate a 32-bit packet counter
  * 2 32-bit packet counters share the location of a 64-bit octet counter
@@ -583,6 +585,73 @@ int rtl83xx_packet_cntr_alloc(struct rtl838x_switch_priv *priv)
 	return idx;
 }
 
+/* Move a PIE rule to a free index of the same block. The rule is written
+ * to its new location before the old one is reused, so it stays active
+ * throughout. Caller must hold priv->pie_mutex
+ */
+static void rtl83xx_pie_rule_move(struct rtl838x_switch_priv *priv, int from, int to)
+{
+	struct pie_rule *pr = priv->pie_rules[from];
+
+	pr_debug("%s: moving rule from %d to %d\n", __func__, from, to);
+	priv->r->pie_rule_write(priv, to, pr);
+	pr->id = to;
+	priv->pie_rules[to] = pr;
+	set_bit(to, priv->pie_use_bm);
+}
+
+/* Find the index in a PIE block for a rule of priority prio. Within a block
+ * the first matching rule wins, so rules are kept sorted by priority with
+ * the lowest value first. If the index is taken, the rules in between are
+ * shifted towards the nearest free entry of the block, which also compacts
+ * holes left by removed rules. All moves are done in one pass.
+ * Returns the index or -1 if the block is full.
+ * Caller must hold priv->pie_mutex
+ */
+int rtl83xx_pie_slot_alloc(struct rtl838x_switch_priv *priv, int block, u32 prio)
+{
+	int first = block * PIE_BLOCK_SIZE;
+	int last = first + PIE_BLOCK_SIZE - 1;
+	int pos = first, up = -1, down = -1;
+
+	/* Go behind all rules of higher or equal priority */
+	for (int i = first; i <= last; i++) {
+		if (test_bit(i, priv->pie_use_bm) && priv->pie_rules[i]->prio <= prio)
+			pos = i + 1;
+	}
+
+	if (pos <= last && !test_bit(pos, priv->pie_use_bm))
+		return pos;
+
+	for (int i = pos; i <= last; i++) {
+		if (!test_bit(i, priv->pie_use_bm)) {
+			up = i;
+			break;
+		}
+	}
+
+	for (int i = pos - 1; i >= first; i--) {
+		if (!test_bit(i, priv->pie_use_bm)) {
+			down = i;
+			break;
+		}
+	}
+
+	if (up < 0 && down < 0)
+		return -1;
+
+	if (up >= 0 && (down < 0 || up - pos <= pos - 1 - down)) {
+		for (int i = up; i > pos; i--)
+			rtl83xx_pie_rule_move(priv, i - 1, i);
+		return pos;
+	}
+
+	for (int i = down; i < pos - 1; i++)
+		rtl83xx_pie_rule_move(priv, i + 1, i);
+
+	return pos - 1;
+}
+
 /* Add an L2 nexthop entry for the L3 routing system / PIE forwarding in the SoC
  * Use VID and MAC in rtl838x_l2_entry to identify either a free slot in the L2 hash table
  * or mark an existing entry as a nexthop by setting it's nexthop bit
@@ -782,27 +851,38 @@ static int rtl83xx_netdevice_event(struct notifier_block *this,
 }
 
 const static struct rhashtable_params route_ht_params = {
-	.key_len     = sizeof(u32),
-	.key_offset  = offsetof(struct rtl83xx_route, gw_ip),
+	.key_len     = sizeof(struct in6_addr),
+	.key_offset  = offsetof(struct rtl83xx_route, gw_ip6),
 	.head_offset = offsetof(struct rtl83xx_route, linkage),
 };
 
-/* Updates an L3 next hop entry in the ROUTING table */
-static int rtl83xx_l3_nexthop_update(struct rtl838x_switch_priv *priv,  __be32 ip_addr, u64 mac)
+static void rtl83xx_net6_mask(int prefix_len, struct in6_addr *ip6_m)
+{
+	struct in6_addr all_ones;
+
+	memset(&all_ones, 0xff, sizeof(all_ones));
+	ipv6_addr_prefix(ip6_m, &all_ones, prefix_len);
+}
+
+/* Updates an L3 next hop entry in the ROUTING table
+ * The gateway is given as IPv6 address, IPv4 gateways are IPv4-mapped
+ */
+static int rtl83xx_l3_nexthop_update(struct rtl838x_switch_priv *priv,
+				     const struct in6_addr *gw, u64 mac)
 {
 	struct rtl83xx_route *r;
 	struct rhlist_head *tmp, *list;
 
 	rcu_read_lock();
-	list = rhltable_lookup(&priv->routes, &ip_addr, route_ht_params);
+	list = rhltable_lookup(&priv->routes, gw, route_ht_params);
 	if (!list) {
 		rcu_read_unlock();
 		return -ENOENT;
 	}
 
 	rhl_for_each_entry_rcu(r, tmp, list, linkage) {
-		pr_info("%s: Setting up fwding: ip %pI4, GW mac %016llx\n",
-			__func__, &ip_addr, mac);
+		pr_info("%s: Setting up fwding: ip %pI6c, GW mac %016llx\n",
+			__func__, gw, mac);
 
 		/* Reads the ROUTING table entry associated with the route */
 		priv->r->route_read(r->id, r);
@@ -821,12 +901,18 @@ static int rtl83xx_l3_nexthop_update(struct rtl838x_switch_priv *priv,  __be32 i
 
 		r->attr.valid = true;
 		r->attr.action = ROUTE_ACT_FORWARD;
-		r->attr.type = 0;
+		r->attr.type = r->is_ipv6 ? 2 : 0; /* IPv6 or IPv4 unicast */
 		r->attr.hit = false; /* Reset route-used indicator */
 
 		/* Add PIE entry with dst_ip and prefix_len */
-		r->pr.dip = r->dst_ip;
-		r->pr.dip_m = inet_make_mask(r->prefix_len);
+		if (r->is_ipv6) {
+			r->pr.is_ipv6 = true;
+			r->pr.dip6 = r->dst_ip6;
+			rtl83xx_net6_mask(r->prefix_len, &r->pr.dip6_m);
+		} else {
+			r->pr.dip = r->dst_ip;
+			r->pr.dip_m = inet_make_mask(r->prefix_len);
+		}
 
 		if (r->is_host_route) {
 			int slot = priv->r->find_l3_slot(r, false);
@@ -855,7 +941,9 @@ static int rtl83xx_l3_nexthop_update(struct rtl838x_switch_priv *priv,  __be32 i
 			int pkts = priv->r->packet_cntr_read(r->pr.packet_cntr);
 			pr_info("%s: total packets: %d\n", __func__, pkts);
 
+			mutex_lock(&priv->pie_mutex);
 			priv->r->pie_rule_write(priv, r->pr.id, &r->pr);
+			mutex_unlock(&priv->pie_mutex);
 		}
 	}
 	rcu_read_unlock();
@@ -881,9 +969,12 @@ static int rtl83xx_port_ipv4_resolve(struct rtl838x_switch_priv *priv,
 	 * resolve the neigh.
 	 */
 	if (n->nud_state & NUD_VALID) {
+		struct in6_addr gw;
+
 		mac = ether_addr_to_u64(n->ha);
 		pr_info("%s: resolved mac: %016llx\n", __func__, mac);
-		rtl83xx_l3_nexthop_update(priv, ip_addr, mac);
+		ipv6_addr_set_v4mapped(ip_addr, &gw);
+		rtl83xx_l3_nexthop_update(priv, &gw, mac);
 	} else {
 		pr_info("%s: need to wait\n", __func__);
 		neigh_event_send(n, NULL);
@@ -894,6 +985,35 @@ static int rtl83xx_port_ipv4_resolve(struct rtl838x_switch_priv *priv,
 	return err;
 }
 
+static int rtl83xx_port_ipv6_resolve(struct rtl838x_switch_priv *priv,
+				     struct net_device *dev, struct in6_addr *ip_addr)
+{
+	struct neighbour *n = neigh_lookup(&nd_tbl, ip_addr, dev);
+	u64 mac;
+
+	if (!n) {
+		n = neigh_create(&nd_tbl, ip_addr, dev);
+		if (IS_ERR(n))
+			return PTR_ERR(n);
+	}
+
+	/* Same as for IPv4: install the entry if the neigh is resolved,
+	 * otherwise start neighbour discovery
+	 */
+	if (n->nud_state & NUD_VALID) {
+		mac = ether_addr_to_u64(n->ha);
+		pr_info("%s: resolved mac: %016llx\n", __func__, mac);
+		rtl83xx_l3_nexthop_update(priv, ip_addr, mac);
+	} else {
+		pr_info("%s: need to wait\n", __func__);
+		neigh_event_send(n, NULL);
+	}
+
+	neigh_release(n);
+
+	return 0;
+}
+
 struct rtl83xx_walk_data {
 	struct rtl838x_switch_priv *priv;
 	int port;
@@ -930,7 +1050,8 @@ int rtl83xx_port_dev_lower_find(struct net_device *dev, struct rtl838x_switch_pr
 	return data.port;
 }
 
-static struct rtl83xx_route *rtl83xx_route_alloc(struct rtl838x_switch_priv *priv, u32 ip)
+static struct rtl83xx_route *rtl83xx_route_alloc(struct rtl838x_switch_priv *priv,
+						 const struct in6_addr *gw)
 {
 	struct rtl83xx_route *r;
 	int idx = 0, err;
@@ -938,7 +1059,7 @@ static struct rtl83xx_route *rtl83xx_route_alloc(struct rtl838x_switch_priv *pri
 	mutex_lock(&priv->reg_mutex);
 
 	idx = find_first_zero_bit(priv->route_use_bm, MAX_ROUTES);
-	pr_debug("%s id: %d, ip %pI4\n", __func__, idx, &ip);
+	pr_debug("%s id: %d, ip %pI6c\n", __func__, idx, gw);
 
 	r = kzalloc(sizeof(*r), GFP_KERNEL);
 	if (!r) {
@@ -947,7 +1068,9 @@ static struct rtl83xx_route *rtl83xx_route_alloc(struct rtl838x_switch_priv *pri
 	}
 
 	r->id = idx;
-	r->gw_ip = ip;
+	r->gw_ip6 = *gw;
+	if (ipv6_addr_v4mapped(gw))
+		r->gw_ip = gw->s6_addr32[3];
 	r->pr.id = -1; /* We still need to allocate a rule in HW */
 	r->is_host_route = false;
 
@@ -959,6 +1082,7 @@ static struct rtl83xx_route *rtl83xx_route_alloc(struct rtl838x_switch_priv *pri
 	}
 
 	set_bit(idx, priv->route_use_bm);
+	list_add(&r->list, &priv->route_list);
 
 	mutex_unlock(&priv->reg_mutex);
 
@@ -971,7 +1095,8 @@ out_free:
 }
 
 
-static struct rtl83xx_route *rtl83xx_host_route_alloc(struct rtl838x_switch_priv *priv, u32 ip)
+static struct rtl83xx_route *rtl83xx_host_route_alloc(struct rtl838x_switch_priv *priv,
+						 const struct in6_addr *gw)
 {
 	struct rtl83xx_route *r;
 	int idx = 0, err;
@@ -979,7 +1104,7 @@ static struct rtl83xx_route *rtl83xx_host_route_alloc(struct rtl838x_switch_priv
 	mutex_lock(&priv->reg_mutex);
 
 	idx = find_first_zero_bit(priv->host_route_use_bm, MAX_HOST_ROUTES);
-	pr_debug("%s id: %d, ip %pI4\n", __func__, idx, &ip);
+	pr_debug("%s id: %d, ip %pI6c\n", __func__, idx, gw);
 
 	r = kzalloc(sizeof(*r), GFP_KERNEL);
 	if (!r) {
@@ -992,7 +1117,9 @@ static struct rtl83xx_route *rtl83xx_host_route_alloc(struct rtl838x_switch_priv
 	 */
 	r->id = idx + MAX_ROUTES;
 
-	r->gw_ip = ip;
+	r->gw_ip6 = *gw;
+	if (ipv6_addr_v4mapped(gw))
+		r->gw_ip = gw->s6_addr32[3];
 	r->pr.id = -1; /* We still need to allocate a rule in HW */
 	r->is_host_route = true;
 
@@ -1004,6 +1131,7 @@ static struct rtl83xx_route *rtl83xx_host_route_alloc(struct rtl838x_switch_priv
 	}
 
 	set_bit(idx, priv->host_route_use_bm);
+	list_add(&r->list, &priv->route_list);
 
 	mutex_unlock(&priv->reg_mutex);
 
@@ -1023,6 +1151,7 @@ static void rtl83xx_route_rm(struct rtl838x_switch_priv *priv, struct rtl83xx_ro
 
 	if (rhltable_remove(&priv->routes, &r->linkage, route_ht_params))
 		dev_warn(priv->dev, "Could not remove route\n");
+	list_del(&r->list);
 
 	if (r->is_host_route) {
 		id = priv->r->find_l3_slot(r, false);
@@ -1036,7 +1165,8 @@ static void rtl83xx_route_rm(struct rtl838x_switch_priv *priv, struct rtl83xx_ro
 			id = priv->r->route_lookup_hw(r);
 			pr_info("%s: Got id for prefix route: %d\n", __func__, id);
 			r->attr.valid = false;
-			priv->r->route_write(id, r);
+			if (id >= 0)
+				priv->r->route_write(id, r);
 		}
 		clear_bit(r->id, priv->route_use_bm);
 	}
@@ -1050,10 +1180,17 @@ static int rtl83xx_fib4_del(struct rtl838x_switch_priv *priv,
 	struct fib_nh *nh = fib_info_nh(info->fi, 0);
 	struct rtl83xx_route *r;
 	struct rhlist_head *tmp, *list;
+	struct in6_addr gw;
 
 	pr_debug("In %s, ip %pI4, len %d\n", __func__, &info->dst, info->dst_len);
+
+	/* Multipath routes are never offloaded, see rtl83xx_fib4_add() */
+	if (fib_info_num_path(info->fi) > 1)
+		return 0;
+
+	ipv6_addr_set_v4mapped(nh->fib_nh_gw4, &gw);
 	rcu_read_lock();
-	list = rhltable_lookup(&priv->routes, &nh->fib_nh_gw4, route_ht_params);
+	list = rhltable_lookup(&priv->routes, &gw, route_ht_params);
 	if (!list) {
 		rcu_read_unlock();
 		pr_err("%s: no such gateway: %pI4\n", __func__, &nh->fib_nh_gw4);
@@ -1166,6 +1303,24 @@ static int rtl83xx_alloc_egress_intf(struct rtl838x_switch_priv *priv, u64 mac,
 	return free_mac;
 }
 
+/* ECMP groups are not supported, flag routes that stay in software so
+ * this is visible in the route dump (rt_offload_failed) instead of silent
+ */
+static void rtl83xx_fib4_offload_failed(struct fib_entry_notifier_info *info)
+{
+	struct fib_rt_info fri = {
+		.fi = info->fi,
+		.tb_id = info->tb_id,
+		.dst = cpu_to_be32(info->dst),
+		.dst_len = info->dst_len,
+		.tos = info->tos,
+		.type = info->type,
+		.offload_failed = true,
+	};
+
+	fib_alias_hw_flags_set(&init_net, &fri);
+}
+
 static int rtl83xx_fib4_add(struct rtl838x_switch_priv *priv,
 			    struct fib_entry_notifier_info *info)
 {
@@ -1173,6 +1328,7 @@ static int rtl83xx_fib4_add(struct rtl838x_switch_priv *priv,
 	struct net_device *dev = fib_info_nh(info->fi, 0)->fib_nh_dev;
 	int port;
 	struct rtl83xx_route *r;
+	struct in6_addr gw;
 	bool to_localhost;
 	int vlan = is_vlan_dev(dev) ? vlan_dev_vlan_id(dev) : 0;
 
@@ -1182,6 +1338,15 @@ static int rtl83xx_fib4_add(struct rtl838x_switch_priv *priv,
 		return 0;
 	}
 
+	/* A route entry points to a single next hop. Leave multipath routes to
+	 * the kernel rather than sending all their traffic to the first one
+	 */
+	if (fib_info_num_path(info->fi) > 1) {
+		pr_debug("Not offloading multipath route\n");
+		rtl83xx_fib4_offload_failed(info);
+		return 0;
+	}
+
 	pr_debug("GW: %pI4, interface name %s, mac %016llx, vlan %d\n", &nh->fib_nh_gw4, dev->name,
 		ether_addr_to_u64(dev->dev_addr), vlan
 	);
@@ -1206,10 +1371,11 @@ static int rtl83xx_fib4_add(struct rtl838x_switch_priv *priv,
 		return 0;
 
 	/* Allocate route or host-route (entry if hardware supports this) */
+	ipv6_addr_set_v4mapped(nh->fib_nh_gw4, &gw);
 	if (info->dst_len == 32 && priv->r->host_route_write)
-		r = rtl83xx_host_route_alloc(priv, nh->fib_nh_gw4);
+		r = rtl83xx_host_route_alloc(priv, &gw);
 	else
-		r = rtl83xx_route_alloc(priv, nh->fib_nh_gw4);
+		r = rtl83xx_route_alloc(priv, &gw);
 
 	if (!r) {
 		pr_err("%s: No more free route entries\n", __func__);
@@ -1262,20 +1428,193 @@ out_free_rt:
 	return 0;
 }
 
+static struct rtl83xx_route *rtl83xx_fib6_route_find(struct rtl838x_switch_priv *priv,
+						     struct fib6_info *rt6)
+{
+	struct rtl83xx_route *r, *found = NULL;
+	struct rhlist_head *tmp, *list;
+
+	/* Routes using nexthop objects are not offloaded */
+	if (rt6->nh)
+		return NULL;
+
+	rcu_read_lock();
+	list = rhltable_lookup(&priv->routes, &rt6->fib6_nh->fib_nh_gw6, route_ht_params);
+	rhl_for_each_entry_rcu(r, tmp, list, linkage) {
+		if (r->is_ipv6 && r->prefix_len == rt6->fib6_dst.plen &&
+		    ipv6_addr_equal(&r->dst_ip6, &rt6->fib6_dst.addr)) {
+			found = r;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return found;
+}
+
+static int rtl83xx_fib6_del(struct rtl838x_switch_priv *priv,
+			    struct fib6_entry_notifier_info *info)
+{
+	struct fib6_nh *nh = info->rt->fib6_nh;
+	struct rtl83xx_route *r;
+
+	pr_debug("In %s, ip %pI6c, len %d\n", __func__,
+		 &info->rt->fib6_dst.addr, info->rt->fib6_dst.plen);
+
+	r = rtl83xx_fib6_route_find(priv, info->rt);
+	if (!r)
+		return 0;
+
+	/* The nexthop and PIE rule only exist once the gateway was resolved */
+	if (r->pr.id >= 0) {
+		rtl83xx_l2_nexthop_rm(priv, &r->nh);
+
+		pr_debug("%s: Releasing packet counter %d\n", __func__, r->pr.packet_cntr);
+		if (r->pr.packet_cntr >= 0)
+			set_bit(r->pr.packet_cntr, priv->packet_cntr_use_bm);
+		priv->r->pie_rule_rm(priv, &r->pr);
+	}
+
+	rtl83xx_route_rm(priv, r);
+
+	nh->fib_nh_flags &= ~RTNH_F_OFFLOAD;
+
+	return 0;
+}
+
+/* IPv6 routes are only offloaded on the RTL93xx, whose prefix route table
+ * holds IPv6 entries. Host routes (/128) also go into that table with the
+ * host-route bit set, as the IPv6 hash of the host route table is unknown.
+ */
 static int rtl83xx_fib6_add(struct rtl838x_switch_priv *priv,
 			    struct fib6_entry_notifier_info *info)
 {
-	pr_debug("In %s\n", __func__);
-/*	nh->fib_nh_flags |= RTNH_F_OFFLOAD; */
+	struct fib6_info *rt6 = info->rt;
+	struct fib6_nh *nh = rt6->fib6_nh;
+	struct net_device *dev;
+	struct rtl83xx_route *r;
+	int vlan, port;
+	u64 mac;
+
+	pr_debug("In %s, ip %pI6c, len %d\n", __func__, &rt6->fib6_dst.addr, rt6->fib6_dst.plen);
+
+	if (!priv->r->set_l3_router_mac || !priv->r->route_lookup_hw)
+		return 0;
+
+	/* Routes using nexthop objects have no fib6_nh */
+	if (rt6->nh || rt6->fib6_type != RTN_UNICAST)
+		return 0;
+
+	dev = nh->fib_nh_dev;
+	if (!dev)
+		return 0;
+
+	if (!rt6->fib6_dst.plen) {
+		pr_info("Not offloading default route for now\n");
+		return 0;
+	}
+
+	if (ipv6_addr_type(&rt6->fib6_dst.addr) & (IPV6_ADDR_LINKLOCAL | IPV6_ADDR_MULTICAST))
+		return 0;
+
+	/* See rtl83xx_fib4_add() */
+	if (info->nsiblings || rt6->fib6_nsiblings) {
+		pr_debug("Not offloading multipath route\n");
+		fib6_info_hw_flags_set(&init_net, rt6, false, false, true);
+		return 0;
+	}
+
+	/* On-link prefixes are left to the kernel, which resolves the hosts */
+	if (nh->fib_nh_gw_family != AF_INET6)
+		return 0;
+
+	port = rtl83xx_port_dev_lower_find(dev, priv);
+	if (port < 0)
+		return -1;
+
+	if (rtl83xx_fib6_route_find(priv, rt6))
+		return 0;
+
+	r = rtl83xx_route_alloc(priv, &nh->fib_nh_gw6);
+	if (!r) {
+		pr_err("%s: No more free route entries\n", __func__);
+		return -1;
+	}
+
+	vlan = is_vlan_dev(dev) ? vlan_dev_vlan_id(dev) : 0;
+	r->is_ipv6 = true;
+	r->attr.type = 2; /* IPv6 unicast */
+	r->dst_ip6 = rt6->fib6_dst.addr;
+	r->prefix_len = rt6->fib6_dst.plen;
+	r->nh.rvid = vlan;
+
+	mac = ether_addr_to_u64(dev->dev_addr);
+	if (rtl83xx_alloc_router_mac(priv, mac))
+		goto out_free_rt;
+
+	r->nh.if_id = rtl83xx_alloc_egress_intf(priv, mac, vlan);
+	if (r->nh.if_id < 0)
+		goto out_free_rt;
+
+	/* We need to resolve the mac address of the GW */
+	rtl83xx_port_ipv6_resolve(priv, dev, &nh->fib_nh_gw6);
+
+	nh->fib_nh_flags |= RTNH_F_OFFLOAD;
+
+	return 0;
+
+out_free_rt:
+	rtl83xx_route_rm(priv, r);
 
 	return 0;
 }
 
+#define RTL83XX_ROUTE_HIT_INTERVAL	(5 * HZ)
+
+/* Routed packets bypass the kernel, so the gateway neighbours of offloaded
+ * routes are never confirmed and expire while traffic is flowing. Poll the
+ * hit bits of the prefix routes and report activity to the neighbour tables.
+ */
+static void rtl83xx_route_hit_work_do(struct work_struct *work)
+{
+	struct rtl838x_switch_priv *priv =
+		container_of(work, struct rtl838x_switch_priv, route_hit_work.work);
+	struct rtl83xx_route *r, hw;
+	struct neighbour *n;
+
+	rtnl_lock();
+	list_for_each_entry(r, &priv->route_list, list) {
+		/* Host routes are hashed, unresolved routes not yet written */
+		if (r->is_host_route || r->pr.id < 0)
+			continue;
+
+		priv->r->route_read(r->id, &hw);
+		if (!hw.attr.valid || !hw.attr.hit)
+			continue;
+
+		if (r->is_ipv6)
+			n = neigh_lookup_nodev(&nd_tbl, &init_net, &r->gw_ip6);
+		else
+			n = neigh_lookup_nodev(&arp_tbl, &init_net, &r->gw_ip);
+		if (n) {
+			neigh_event_send(n, NULL);
+			neigh_release(n);
+		}
+
+		/* Clear the hit bit for the next interval */
+		r->attr.hit = false;
+		priv->r->route_write(r->id, r);
+	}
+	rtnl_unlock();
+
+	schedule_delayed_work(&priv->route_hit_work, RTL83XX_ROUTE_HIT_INTERVAL);
+}
+
 struct net_event_work {
 	struct work_struct work;
 	struct rtl838x_switch_priv *priv;
 	u64 mac;
-	u32 gw_addr;
+	struct in6_addr gw_addr;	/* IPv4 gateways are IPv4-mapped */
 };
 
 static void rtl83xx_net_event_work_do(struct work_struct *work)
@@ -1284,7 +1623,10 @@ static void rtl83xx_net_event_work_do(struct work_struct *work)
 		container_of(work, struct net_event_work, work);
 	struct rtl838x_switch_priv *priv = net_work->priv;
 
-	rtl83xx_l3_nexthop_update(priv, net_work->gw_addr, net_work->mac);
+	/* Serialize against the FIB and route hit workers */
+	rtnl_lock();
+	rtl83xx_l3_nexthop_update(priv, &net_work->gw_addr, net_work->mac);
+	rtnl_unlock();
 
 	kfree(net_work);
 }
@@ -1302,7 +1644,7 @@ static int rtl83xx_netevent_event(struct notifier_block *this,
 
 	switch (event) {
 	case NETEVENT_NEIGH_UPDATE:
-		if (n->tbl != &arp_tbl)
+		if (n->tbl != &arp_tbl && n->tbl != &nd_tbl)
 			return NOTIFY_DONE;
 		dev = n->dev;
 		port = rtl83xx_port_dev_lower_find(dev, priv);
@@ -1319,7 +1661,10 @@ static int rtl83xx_netevent_event(struct notifier_block *this,
 		net_work->priv = priv;
 
 		net_work->mac = ether_addr_to_u64(n->ha);
-		net_work->gw_addr = *(__be32 *) n->primary_key;
+		if (n->tbl == &nd_tbl)
+			net_work->gw_addr = *(struct in6_addr *) n->primary_key;
+		else
+			ipv6_addr_set_v4mapped(*(__be32 *) n->primary_key, &net_work->gw_addr);
 
 		pr_debug("%s: updating neighbour on port %d, mac %016llx\n",
 			__func__, port, net_work->mac);
@@ -1361,6 +1706,7 @@ static void rtl83xx_fib_event_work_do(struct work_struct *work)
 	case FIB_EVENT_ENTRY_APPEND:
 		if (fib_work->is_fib6) {
 			err = rtl83xx_fib6_add(priv, &fib_work->fen6_info);
+			fib6_info_release(fib_work->fen6_info.rt);
 		} else {
 			err = rtl83xx_fib4_add(priv, &fib_work->fen_info);
 			fib_info_put(fib_work->fen_info.fi);
@@ -1369,8 +1715,13 @@ static void rtl83xx_fib_event_work_do(struct work_struct *work)
 			pr_err("%s: FIB4 failed\n", __func__);
 		break;
 	case FIB_EVENT_ENTRY_DEL:
-		rtl83xx_fib4_del(priv, &fib_work->fen_info);
-		fib_info_put(fib_work->fen_info.fi);
+		if (fib_work->is_fib6) {
+			rtl83xx_fib6_del(priv, &fib_work->fen6_info);
+			fib6_info_release(fib_work->fen6_info.rt);
+		} else {
+			rtl83xx_fib4_del(priv, &fib_work->fen_info);
+			fib_info_put(fib_work->fen_info.fi);
+		}
 		break;
 	case FIB_EVENT_RULE_ADD:
 	case FIB_EVENT_RULE_DEL:
@@ -1430,10 +1781,12 @@ static int rtl83xx_fib_event(struct notifier_block *this, unsigned long event, v
 			fib_info_hold(fib_work->fen_info.fi);
 
 		} else if (info->family == AF_INET6) {
-			//struct fib6_entry_notifier_info *fen6_info = ptr;
-			pr_warn("%s: FIB_RULE ADD/DEL for IPv6 not supported\n", __func__);
-			kfree(fib_work);
-			return NOTIFY_DONE;
+			struct fib6_entry_notifier_info *fen6_info = ptr;
+
+			memcpy(&fib_work->fen6_info, ptr, sizeof(fib_work->fen6_info));
+			/* Same as for the fib_info above */
+			fib6_info_hold(fen6_info->rt);
+			fib_work->is_fib6 = true;
 		}
 		break;
 
@@ -1626,6 +1979,9 @@ static int __init rtl83xx_sw_probe(struct platform_device *pdev)
 
 	/* Initialize hash table for L3 routing */
 	rhltable_init(&priv->routes, &route_ht_params);
+	INIT_LIST_HEAD(&priv->route_list);
+
+	INIT_DELAYED_WORK(&priv->route_hit_work, rtl83xx_route_hit_work_do);
 
 	/* Register netevent notifier callback to catch notifications about neighboring
 	 * changes to update nexthop entries for L3 routing.
@@ -1662,6 +2018,14 @@ static int __init rtl83xx_sw_probe(struct platform_device *pdev)
 		rtl930x_dbgfs_init(priv);
 	}
 
+	platform_set_drvdata(pdev, priv);
+
+	/* Only the RTL930x reports route hits. Start polling only once nothing
+	 * can fail anymore, the work re-arms itself and uses the devm priv.
+	 */
+	if (priv->family_id == RTL9300_FAMILY_ID)
+		schedule_delayed_work(&priv->route_hit_work, RTL83XX_ROUTE_HIT_INTERVAL);
+
 	return 0;
 
 err_register_fib_nb:
@@ -1669,14 +2033,26 @@ err_register_fib_nb:
 err_register_ne_nb:
 	unregister_netdevice_notifier(&priv->nb);
 err_register_nb:
+	cancel_delayed_work_sync(&priv->route_hit_work);
 	return err;
 }
 
 static int rtl83xx_sw_remove(struct platform_device *pdev)
 {
+	struct rtl838x_switch_priv *priv = platform_get_drvdata(pdev);
+
 	/* TODO: */
 	pr_debug("Removing platform driver for rtl83xx-sw\n");
 
+	if (!priv)
+		return 0;
+
+	/* Stop everything that may still reference the devm allocated priv */
+	unregister_fib_notifier(&init_net, &priv->fib_nb);
+	unregister_netevent_notifier(&priv->ne_nb);
+	unregister_netdevice_notifier(&priv->nb);
+	cancel_delayed_work_sync(&priv->route_hit_work);
+
 	return 0;
 }
 
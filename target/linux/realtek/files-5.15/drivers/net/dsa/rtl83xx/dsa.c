@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <net/dsa.h>
+#include <linux/async.h>
 #include <linux/etherdevice.h>
 #include <linux/if_bridge.h>
 #include <asm/mach-rtl838x/mach-rtl83xx.h>
@@ -30,6 +31,11 @@ static void rtl83xx_enable_phy_polling(struct rtl838x_switch_priv *priv)
 	u64 v = 0;
 
 	msleep(1000);
+	/* The PHY driver patches PHY packages asynchronously, polling must not
+	 * start while that is still going on
+	 */
+	async_synchronize_full();
+
 	/* Enable all ports with a PHY, including the SFP-ports */
 	for (int i = 0; i < priv->cpu_port; i++) {
 		if (priv->ports[i].phy)
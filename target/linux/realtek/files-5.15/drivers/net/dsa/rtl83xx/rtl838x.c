@@ -1400,8 +1400,6 @@ static bool rtl838x_pie_templ_has(int t, enum template_field_id field_type)
 static int rtl838x_pie_verify_template(struct rtl838x_switch_priv *priv,
 				       struct pie_rule *pr, int t, int block)
 {
-	int i;
-
 	if (!pr->is_ipv6 && pr->sip_m && !rtl838x_pie_templ_has(t, TEMPLATE_FIELD_SIP0))
 		return -1;
 
@@ -1431,12 +1429,7 @@ static int rtl838x_pie_verify_template(struct rtl838x_switch_priv *priv,
 
 	/* TODO: Check more */
 
-	i = find_first_zero_bit(&priv->pie_use_bm[block * 4], PIE_BLOCK_SIZE);
-
-	if (i >= PIE_BLOCK_SIZE)
-		return -1;
-
-	return i + PIE_BLOCK_SIZE * block;
+	return rtl83xx_pie_slot_alloc(priv, block, pr->prio);
 }
 
 static int rtl838x_pie_rule_add(struct rtl838x_switch_priv *priv, struct pie_rule *pr)
@@ -1466,6 +1459,7 @@ static int rtl838x_pie_rule_add(struct rtl838x_switch_priv *priv, struct pie_rul
 
 	pr_debug("Using block: %d, index %d, template-id %d\n", block, idx, j);
 	set_bit(idx, priv->pie_use_bm);
+	priv->pie_rules[idx] = pr;
 
 	pr->valid = true;
 	pr->tid = j;  /* Mapped to template number */
@@ -1482,10 +1476,17 @@ static int rtl838x_pie_rule_add(struct rtl838x_switch_priv *priv, struct pie_rul
 
 static void rtl838x_pie_rule_rm(struct rtl838x_switch_priv *priv, struct pie_rule *pr)
 {
-	int idx = pr->id;
+	int idx;
 
+	/* The allocator may move the rule while making room for others */
+	mutex_lock(&priv->pie_mutex);
+
+	idx = pr->id;
 	rtl838x_pie_rule_del(priv, idx, idx);
 	clear_bit(idx, priv->pie_use_bm);
+	priv->pie_rules[idx] = NULL;
+
+	mutex_unlock(&priv->pie_mutex);
 }
 
 /* Initializes the Packet Inspection Engine:
@@ -1571,6 +1572,24 @@ static void rtl838x_packet_cntr_clear(int counter)
 	rtl_table_release(r);
 }
 
+/* Read all LOG table entries in use into log[], 2 registers per entry.
+ * Caller must hold priv->reg_mutex
+ */
+static void rtl838x_log_read_bulk(struct rtl838x_switch_priv *priv, u32 *log)
+{
+	/* Read LOG table (3) via register RTL8380_TBL_0 */
+	struct table_reg *r = rtl_table_get(RTL8380_TBL_0, 3);
+	int i;
+
+	for_each_set_bit(i, priv->octet_cntr_use_bm, priv->n_counters) {
+		rtl_table_read(r, i);
+		log[i * 2] = sw_r32(rtl_table_data(r, 0));
+		log[i * 2 + 1] = sw_r32(rtl_table_data(r, 1));
+	}
+
+	rtl_table_release(r);
+}
+
 static void rtl838x_route_read(int idx, struct rtl83xx_route *rt)
 {
 	/* Read ROUTING table (2) via register RTL8380_TBL_1 */
@@ -1767,6 +1786,7 @@ const struct rtl838x_reg rtl838x_reg = {
 	.l2_learning_setup = rtl838x_l2_learning_setup,
 	.packet_cntr_read = rtl838x_packet_cntr_read,
 	.packet_cntr_clear = rtl838x_packet_cntr_clear,
+	.log_read_bulk = rtl838x_log_read_bulk,
 	.route_read = rtl838x_route_read,
 	.route_write = rtl838x_route_write,
 	.l3_setup = rtl838x_l3_setup,
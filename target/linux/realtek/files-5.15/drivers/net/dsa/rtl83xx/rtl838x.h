@@ -723,6 +723,7 @@ enum egr_filter {
 struct pie_rule {
 	int id;
 	enum pie_phase phase;	/* Phase in which this template is applied */
+	u32 prio;		/* Rules with lower values are placed first in a block */
 	int packet_cntr;	/* ID of a packet counter assigned to this rule */
 	int octet_cntr;		/* ID of a byte counter assigned to this rule */
 	u32 last_packet_cnt;
@@ -938,12 +939,15 @@ struct rtl93xx_route_attr {
 
 struct rtl83xx_route {
 	u32 gw_ip;			/* IP of the route's gateway */
+	struct in6_addr gw_ip6;		/* Hash key, IPv4 gateways are IPv4-mapped */
 	u32 dst_ip;			/* IP of the destination net */
 	struct in6_addr dst_ip6;
 	int prefix_len;			/* Network prefix len of the destination net */
 	bool is_host_route;
+	bool is_ipv6;
 	int id;				/* ID number of this route */
 	struct rhlist_head linkage;
+	struct list_head list;		/* Entry in priv->route_list, protected by RTNL */
 	u16 switch_mac_id;		/* Index into switch's own MACs, RTL839X only */
 	struct rtl83xx_nexthop nh;
 	struct pie_rule pr;
@@ -1031,6 +1035,7 @@ struct rtl838x_reg {
 	void (*l2_learning_setup)(void);
 	u32 (*packet_cntr_read)(int counter);
 	void (*packet_cntr_clear)(int counter);
+	void (*log_read_bulk)(struct rtl838x_switch_priv *priv, u32 *log);
 	void (*route_read)(int idx, struct rtl83xx_route *rt);
 	void (*route_write)(int idx, struct rtl83xx_route *rt);
 	void (*host_route_write)(int idx, struct rtl83xx_route *rt);
@@ -1085,10 +1090,15 @@ struct rtl838x_switch_priv {
 	int n_pie_blocks;
 	struct rhashtable tc_ht;
 	unsigned long int pie_use_bm[MAX_PIE_ENTRIES >> 5];
+	struct pie_rule *pie_rules[MAX_PIE_ENTRIES];
 	int n_counters;
 	unsigned long int octet_cntr_use_bm[MAX_COUNTERS >> 5];
 	unsigned long int packet_cntr_use_bm[MAX_COUNTERS >> 4];
+	u32 *log_cache;		/* Copy of the LOG table, 2 registers per entry */
+	unsigned long log_cache_updated;
 	struct rhltable routes;
+	struct list_head route_list;
+	struct delayed_work route_hit_work;
 	unsigned long int route_use_bm[MAX_ROUTES >> 5];
 	unsigned long int host_route_use_bm[MAX_HOST_ROUTES >> 5];
 	struct rtl838x_l3_intf *interfaces[MAX_INTERFACES];
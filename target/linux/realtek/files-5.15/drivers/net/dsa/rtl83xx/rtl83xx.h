@@ -76,6 +76,8 @@ inline void rtl_table_data_w(struct table_reg *r, u32 v, int i);
 void __init rtl83xx_setup_qos(struct rtl838x_switch_priv *priv);
 
 int rtl83xx_packet_cntr_alloc(struct rtl838x_switch_priv *priv);
+int rtl83xx_octet_cntr_alloc(struct rtl838x_switch_priv *priv);
+int rtl83xx_pie_slot_alloc(struct rtl838x_switch_priv *priv, int block, u32 prio);
 
 int rtl83xx_port_is_under(const struct net_device * dev, struct rtl838x_switch_priv *priv);
 
@@ -3,6 +3,7 @@
 #include <asm/mach-rtl838x/mach-rtl83xx.h>
 #include <linux/etherdevice.h>
 #include <linux/inetdevice.h>
+#include <net/ipv6.h>
 
 #include "rtl83xx.h"
 
@@ -1070,13 +1071,13 @@ static void rtl930x_route_read(int idx, struct rtl83xx_route *rt)
 	host_route = !!(v & BIT(21));
 	default_route = !!(v & BIT(20));
 	rt->prefix_len = -1;
-	pr_info("%s: host route %d, default_route %d\n", __func__, host_route, default_route);
+	pr_debug("%s: host route %d, default_route %d\n", __func__, host_route, default_route);
 
 	switch (rt->attr.type) {
 	case 0: /* IPv4 Unicast route */
 		rt->dst_ip = sw_r32(rtl_table_data(r, 4));
 		ip4_m = sw_r32(rtl_table_data(r, 9));
-		pr_info("%s: Read ip4 mask: %08x\n", __func__, ip4_m);
+		pr_debug("%s: Read ip4 mask: %08x\n", __func__, ip4_m);
 		rt->prefix_len = host_route ? 32 : -1;
 		rt->prefix_len = (rt->prefix_len < 0 && default_route) ? 0 : -1;
 		if (rt->prefix_len < 0)
@@ -1089,11 +1090,10 @@ static void rtl930x_route_read(int idx, struct rtl83xx_route *rt)
 		ipv6_addr_set(&ip6_m,
 			      sw_r32(rtl_table_data(r, 6)), sw_r32(rtl_table_data(r, 7)),
 			      sw_r32(rtl_table_data(r, 8)), sw_r32(rtl_table_data(r, 9)));
-		rt->prefix_len = host_route ? 128 : 0;
-		rt->prefix_len = (rt->prefix_len < 0 && default_route) ? 0 : -1;
-		if (rt->prefix_len < 0)
-			rt->prefix_len = find_last_bit((unsigned long int *)&ip6_m.s6_addr32,
-							 128);
+		/* Prefix masks are contiguous, host and default routes included */
+		rt->prefix_len = 0;
+		for (int i = 0; i < 4; i++)
+			rt->prefix_len += hweight32(ip6_m.s6_addr32[i]);
 		break;
 	case 1: /* IPv4 Multicast route */
 	case 3: /* IPv6 Multicast route */
@@ -1109,23 +1109,24 @@ static void rtl930x_route_read(int idx, struct rtl83xx_route *rt)
 	rt->attr.dst_null = !!(v & BIT(4));
 	rt->attr.qos_as = !!(v & BIT(3));
 	rt->attr.qos_prio =  v & 0x7;
-	pr_info("%s: index %d is valid: %d\n", __func__, idx, rt->attr.valid);
-	pr_info("%s: next_hop: %d, hit: %d, action :%d, ttl_dec %d, ttl_check %d, dst_null %d\n",
+	pr_debug("%s: index %d is valid: %d\n", __func__, idx, rt->attr.valid);
+	pr_debug("%s: next_hop: %d, hit: %d, action :%d, ttl_dec %d, ttl_check %d, dst_null %d\n",
 		__func__, rt->nh.id, rt->attr.hit, rt->attr.action,
 		rt->attr.ttl_dec, rt->attr.ttl_check, rt->attr.dst_null);
-	pr_info("%s: GW: %pI4, prefix_len: %d\n", __func__, &rt->dst_ip, rt->prefix_len);
+	pr_debug("%s: GW: %pI4, prefix_len: %d\n", __func__, &rt->dst_ip, rt->prefix_len);
 out:
 	rtl_table_release(r);
 }
 
 static void rtl930x_net6_mask(int prefix_len, struct in6_addr *ip6_m)
 {
-	int o, b;
-	/* Define network mask */
-	o = prefix_len >> 3;
-	b = prefix_len & 0x7;
-	memset(ip6_m->s6_addr, 0xff, o);
-	ip6_m->s6_addr[o] |= b ? 0xff00 >> b : 0x00;
+	struct in6_addr all_ones;
+
+	/* The old open coded version left the host part uninitialised and
+	 * wrote past the end of the address for /128 host routes
+	 */
+	memset(&all_ones, 0xff, sizeof(all_ones));
+	ipv6_addr_prefix(ip6_m, &all_ones, prefix_len);
 }
 
 /* Read a host route entry from the table using its index
@@ -1246,11 +1247,11 @@ static int rtl930x_route_lookup_hw(struct rtl83xx_route *rt)
 	if (rt->attr.type == 1 || rt->attr.type == 3) /* Hardware only supports UC routes */
 		return -1;
 
-	sw_w32_mask(0x3 << 19, rt->attr.type, RTL930X_L3_HW_LU_KEY_CTRL);
+	sw_w32_mask(0x3 << 19, rt->attr.type << 19, RTL930X_L3_HW_LU_KEY_CTRL);
 	if (rt->attr.type) { /* IPv6 */
 		rtl930x_net6_mask(rt->prefix_len, &ip6_m);
 		for (int i = 0; i < 4; i++)
-			sw_w32(rt->dst_ip6.s6_addr32[0] & ip6_m.s6_addr32[0],
+			sw_w32(rt->dst_ip6.s6_addr32[i] & ip6_m.s6_addr32[i],
 			       RTL930X_L3_HW_LU_KEY_IP_CTRL + (i << 2));
 	} else { /* IPv4 */
 		ip4_m = inet_make_mask(rt->prefix_len);
@@ -1367,6 +1368,9 @@ static void rtl930x_route_write(int idx, struct rtl83xx_route *rt)
 		sw_w32(rt->dst_ip6.s6_addr32[2], rtl_table_data(r, 3));
 		sw_w32(rt->dst_ip6.s6_addr32[3], rtl_table_data(r, 4));
 
+		/* /128 routes live in this table too, the IPv6 hash of the
+		 * host route table is not implemented
+		 */
 		v |= rt->prefix_len == 128 ? BIT(21) : 0; /* set host-route bit */
 
 		rtl930x_net6_mask(rt->prefix_len, &ip6_m);
@@ -1889,8 +1893,6 @@ static bool rtl930x_pie_templ_has(int t, enum template_field_id field_type)
 static int rtl930x_pie_verify_template(struct rtl838x_switch_priv *priv,
 				       struct pie_rule *pr, int t, int block)
 {
-	int i;
-
 	if (!pr->is_ipv6 && pr->sip_m && !rtl930x_pie_templ_has(t, TEMPLATE_FIELD_SIP0))
 		return -1;
 
@@ -1920,12 +1922,7 @@ static int rtl930x_pie_verify_template(struct rtl838x_switch_priv *priv,
 
 	/* TODO: Check more */
 
-	i = find_first_zero_bit(&priv->pie_use_bm[block * 4], PIE_BLOCK_SIZE);
-
-	if (i >= PIE_BLOCK_SIZE)
-		return -1;
-
-	return i + PIE_BLOCK_SIZE * block;
+	return rtl83xx_pie_slot_alloc(priv, block, pr->prio);
 }
 
 static int rtl930x_pie_rule_add(struct rtl838x_switch_priv *priv, struct pie_rule *pr)
@@ -1963,6 +1960,7 @@ static int rtl930x_pie_rule_add(struct rtl838x_switch_priv *priv, struct pie_rul
 
 	pr_debug("Using block: %d, index %d, template-id %d\n", block, idx, j);
 	set_bit(idx, priv->pie_use_bm);
+	priv->pie_rules[idx] = pr;
 
 	pr->valid = true;
 	pr->tid = j;  /* Mapped to template number */
@@ -1997,10 +1995,17 @@ static int rtl930x_pie_rule_del(struct rtl838x_switch_priv *priv, int index_from
 
 static void rtl930x_pie_rule_rm(struct rtl838x_switch_priv *priv, struct pie_rule *pr)
 {
-	int idx = pr->id;
+	int idx;
+
+	/* The allocator may move the rule while making room for others */
+	mutex_lock(&priv->pie_mutex);
 
+	idx = pr->id;
 	rtl930x_pie_rule_del(priv, idx, idx);
 	clear_bit(idx, priv->pie_use_bm);
+	priv->pie_rules[idx] = NULL;
+
+	mutex_unlock(&priv->pie_mutex);
 }
 
 static void rtl930x_pie_init(struct rtl838x_switch_priv *priv)
@@ -2291,6 +2296,24 @@ static void rtl930x_packet_cntr_clear(int counter)
 	rtl_table_release(r);
 }
 
+/* Read all LOG table entries in use into log[], 2 registers per entry.
+ * Caller must hold priv->reg_mutex
+ */
+static void rtl930x_log_read_bulk(struct rtl838x_switch_priv *priv, u32 *log)
+{
+	/* Read LOG table (3) via register RTL9300_TBL_0 */
+	struct table_reg *r = rtl_table_get(RTL9300_TBL_0, 3);
+	int i;
+
+	for_each_set_bit(i, priv->octet_cntr_use_bm, priv->n_counters) {
+		rtl_table_read(r, i);
+		log[i * 2] = sw_r32(rtl_table_data(r, 0));
+		log[i * 2 + 1] = sw_r32(rtl_table_data(r, 1));
+	}
+
+	rtl_table_release(r);
+}
+
 void rtl930x_vlan_port_keep_tag_set(int port, bool keep_outer, bool keep_inner)
 {
 	sw_w32(FIELD_PREP(RTL930X_VLAN_PORT_TAG_STS_CTRL_EGR_OTAG_STS_MASK,
@@ -2527,6 +2550,7 @@ const struct rtl838x_reg rtl930x_reg = {
 	.l2_learning_setup = rtl930x_l2_learning_setup,
 	.packet_cntr_read = rtl930x_packet_cntr_read,
 	.packet_cntr_clear = rtl930x_packet_cntr_clear,
+	.log_read_bulk = rtl930x_log_read_bulk,
 	.route_read = rtl930x_route_read,
 	.route_write = rtl930x_route_write,
 	.host_route_write = rtl930x_host_route_write,
@@ -1307,8 +1307,6 @@ static bool rtl931x_pie_templ_has(int t, enum template_field_id field_type)
 static int rtl931x_pie_verify_template(struct rtl838x_switch_priv *priv,
 				       struct pie_rule *pr, int t, int block)
 {
-	int i;
-
 	if (!pr->is_ipv6 && pr->sip_m && !rtl931x_pie_templ_has(t, TEMPLATE_FIELD_SIP0))
 		return -1;
 
@@ -1338,12 +1336,7 @@ static int rtl931x_pie_verify_template(struct rtl838x_switch_priv *priv,
 
 	/* TODO: Check more */
 
-	i = find_first_zero_bit(&priv->pie_use_bm[block * 4], PIE_BLOCK_SIZE);
-
-	if (i >= PIE_BLOCK_SIZE)
-		return -1;
-
-	return i + PIE_BLOCK_SIZE * block;
+	return rtl83xx_pie_slot_alloc(priv, block, pr->prio);
 }
 
 static int rtl931x_pie_rule_add(struct rtl838x_switch_priv *priv, struct pie_rule *pr)
@@ -1381,6 +1374,7 @@ static int rtl931x_pie_rule_add(struct rtl838x_switch_priv *priv, struct pie_rul
 
 	pr_info("Using block: %d, index %d, template-id %d\n", block, idx, j);
 	set_bit(idx, priv->pie_use_bm);
+	priv->pie_rules[idx] = pr;
 
 	pr->valid = true;
 	pr->tid = j;  /* Mapped to template number */
@@ -1417,10 +1411,17 @@ static int rtl931x_pie_rule_del(struct rtl838x_switch_priv *priv, int index_from
 
 static void rtl931x_pie_rule_rm(struct rtl838x_switch_priv *priv, struct pie_rule *pr)
 {
-	int idx = pr->id;
+	int idx;
 
+	/* The allocator may move the rule while making room for others */
+	mutex_lock(&priv->pie_mutex);
+
+	idx = pr->id;
 	rtl931x_pie_rule_del(priv, idx, idx);
 	clear_bit(idx, priv->pie_use_bm);
+	priv->pie_rules[idx] = NULL;
+
+	mutex_unlock(&priv->pie_mutex);
 }
 
 static void rtl931x_pie_init(struct rtl838x_switch_priv *priv)
@@ -11,6 +11,9 @@
 #include "rtl83xx.h"
 #include "rtl838x.h"
 
+/* Maximum age of the LOG table copy used for flow statistics */
+#define RTL83XX_LOG_CACHE_AGE	(HZ / 10)
+
 /* Parse the flow rule for the matching conditions */
 static int rtl83xx_parse_flow_rule(struct rtl838x_switch_priv *priv,
 			      struct flow_rule *rule, struct rtl83xx_flow *flow)
@@ -231,6 +234,72 @@ static const struct rhashtable_params tc_ht_params = {
 	.automatic_shrinking = true,
 };
 
+/* A counter may be handed out again while the LOG cache still holds the
+ * value of its previous user, drop it along with the hardware counter
+ */
+static void rtl83xx_log_cache_clear(struct rtl838x_switch_priv *priv,
+				    int idx, int n)
+{
+	if (!priv->log_cache)
+		return;
+
+	mutex_lock(&priv->reg_mutex);
+	memset(&priv->log_cache[idx], 0, n * sizeof(u32));
+	mutex_unlock(&priv->reg_mutex);
+}
+
+/* The LOG action of a rule updates a single counter. Where the SoC can count
+ * octets in a 64-bit LOG entry, use that to report real byte counts,
+ * otherwise fall back to a 32-bit packet counter
+ */
+static void rtl83xx_flow_cntr_alloc(struct rtl838x_switch_priv *priv,
+				    struct rtl83xx_flow *flow)
+{
+	struct pie_rule *pr = &flow->rule;
+
+	pr->packet_cntr = -1;
+	pr->octet_cntr = -1;
+
+	if (priv->log_cache &&
+	    (priv->family_id == RTL8390_FAMILY_ID || priv->family_id == RTL9300_FAMILY_ID))
+		pr->octet_cntr = rtl83xx_octet_cntr_alloc(priv);
+
+	if (pr->octet_cntr >= 0) {
+		pr_debug("Using octet counter %d\n", pr->octet_cntr);
+		priv->r->packet_cntr_clear(pr->octet_cntr * 2);
+		priv->r->packet_cntr_clear(pr->octet_cntr * 2 + 1);
+		rtl83xx_log_cache_clear(priv, pr->octet_cntr * 2, 2);
+		pr->log_sel = true;
+		pr->log_octets = true;
+		pr->log_data = pr->octet_cntr;
+		return;
+	}
+
+	pr->packet_cntr = rtl83xx_packet_cntr_alloc(priv);
+	if (pr->packet_cntr >= 0) {
+		pr_debug("Using packet counter %d\n", pr->packet_cntr);
+		if (priv->r->packet_cntr_clear)
+			priv->r->packet_cntr_clear(pr->packet_cntr);
+		/* The cache holds packet counters at the other register */
+		rtl83xx_log_cache_clear(priv, pr->packet_cntr ^ 1, 1);
+		pr->log_sel = true;
+		pr->log_data = pr->packet_cntr;
+	}
+}
+
+static void rtl83xx_flow_cntr_free(struct rtl838x_switch_priv *priv,
+				   struct rtl83xx_flow *flow)
+{
+	mutex_lock(&priv->reg_mutex);
+
+	if (flow->rule.octet_cntr >= 0)
+		clear_bit(flow->rule.octet_cntr, priv->octet_cntr_use_bm);
+	if (flow->rule.packet_cntr >= 0)
+		set_bit(flow->rule.packet_cntr, priv->packet_cntr_use_bm);
+
+	mutex_unlock(&priv->reg_mutex);
+}
+
 static int rtl83xx_configure_flower(struct rtl838x_switch_priv *priv,
 				    struct flow_cls_offload *f)
 {
@@ -270,14 +339,10 @@ rcu_unlock:
 	}
 
 	rtl83xx_add_flow(priv, f, flow); /* TODO: check error */
+	flow->rule.prio = f->common.prio;
 
 	/* Add log action to flow */
-	flow->rule.packet_cntr = rtl83xx_packet_cntr_alloc(priv);
-	if (flow->rule.packet_cntr >= 0) {
-		pr_debug("Using packet counter %d\n", flow->rule.packet_cntr);
-		flow->rule.log_sel = true;
-		flow->rule.log_data = flow->rule.packet_cntr;
-	}
+	rtl83xx_flow_cntr_alloc(priv, flow);
 
 	err = priv->r->pie_rule_add(priv, &flow->rule);
 	return err;
@@ -304,6 +369,7 @@ static int rtl83xx_delete_flower(struct rtl838x_switch_priv *priv,
 	}
 
 	priv->r->pie_rule_rm(priv, &flow->rule);
+	rtl83xx_flow_cntr_free(priv, flow);
 
 	rhashtable_remove_fast(&priv->tc_ht, &flow->node, tc_ht_params);
 
@@ -314,27 +380,68 @@ static int rtl83xx_delete_flower(struct rtl838x_switch_priv *priv,
 	return 0;
 }
 
+/* Refresh the copy of the LOG table at most once per stats cycle, so that
+ * dumping the statistics of all flows costs a single pass over the table.
+ * Caller must hold priv->reg_mutex
+ */
+static void rtl83xx_log_cache_update(struct rtl838x_switch_priv *priv)
+{
+	if (time_before(jiffies, priv->log_cache_updated + RTL83XX_LOG_CACHE_AGE))
+		return;
+
+	priv->r->log_read_bulk(priv, priv->log_cache);
+	priv->log_cache_updated = jiffies;
+}
+
 static int rtl83xx_stats_flower(struct rtl838x_switch_priv *priv,
 				struct flow_cls_offload * cls_flower)
 {
 	struct rtl83xx_flow *flow;
+	struct pie_rule *pr;
 	unsigned long lastused = 0;
-	int total_packets, new_packets;
+	u64 total_octets, new_octets = 0;
+	u32 total_packets, new_packets = 0;
+	bool cached;
 
 	pr_debug("%s: \n", __func__);
 	flow = rhashtable_lookup_fast(&priv->tc_ht, &cls_flower->cookie, tc_ht_params);
 	if (!flow)
 		return -1;
 
-	if (flow->rule.packet_cntr >= 0) {
-		total_packets = priv->r->packet_cntr_read(flow->rule.packet_cntr);
-		pr_debug("Total packets: %d\n", total_packets);
-		new_packets = total_packets - flow->rule.last_packet_cnt;
-		flow->rule.last_packet_cnt = total_packets;
+	pr = &flow->rule;
+	cached = priv->log_cache && priv->r->log_read_bulk;
+
+	mutex_lock(&priv->reg_mutex);
+	if (cached)
+		rtl83xx_log_cache_update(priv);
+
+	if (pr->octet_cntr >= 0) {
+		/* 64-bit octet counters occupy both registers of a LOG entry */
+		total_octets = (u64)priv->log_cache[pr->octet_cntr * 2] << 32;
+		total_octets |= priv->log_cache[pr->octet_cntr * 2 + 1];
+		pr_debug("Total octets: %llu\n", total_octets);
+		new_octets = total_octets - pr->last_octet_cnt;
+		pr->last_octet_cnt = total_octets;
+	} else if (pr->packet_cntr >= 0) {
+		/* The table has a size of 2 registers */
+		if (!cached)
+			total_packets = priv->r->packet_cntr_read(pr->packet_cntr);
+		else if (pr->packet_cntr % 2)
+			total_packets = priv->log_cache[pr->packet_cntr - 1];
+		else
+			total_packets = priv->log_cache[pr->packet_cntr + 1];
+		pr_debug("Total packets: %u\n", total_packets);
+		new_packets = total_packets - pr->last_packet_cnt;
+		pr->last_packet_cnt = total_packets;
+		/* TODO: We need a second PIE rule to count the bytes */
+		new_octets = 100 * new_packets;
 	}
+	mutex_unlock(&priv->reg_mutex);
+
+	if (new_octets)
+		lastused = jiffies;
 
-	/* TODO: We need a second PIE rule to count the bytes */
-	flow_stats_update(&cls_flower->stats, 100 * new_packets, new_packets, 0, lastused,
+	flow_stats_update(&cls_flower->stats, new_octets, new_packets, 0, lastused,
 	                  FLOW_ACTION_HW_STATS_IMMEDIATE);
 
 	return 0;
@@ -395,6 +502,10 @@ int rtl83xx_setup_tc(struct net_device *dev, enum tc_setup_type type, void *type
 			err = rhashtable_init(&priv->tc_ht, &tc_ht_params);
 			if (err)
 				pr_err("%s: Could not initialize hash table\n", __func__);
+			priv->log_cache = devm_kcalloc(priv->dev, priv->n_counters * 2,
+						       sizeof(u32), GFP_KERNEL);
+			/* jiffies starts out negative, make the first read a miss */
+			priv->log_cache_updated = jiffies - RTL83XX_LOG_CACHE_AGE;
 		}
 
 		f->unlocked_driver_cb = true;
@@ -5,6 +5,8 @@
  */
 
 #include <linux/module.h>
+#include <linux/async.h>
+#include <linux/completion.h>
 #include <linux/delay.h>
 #include <linux/of.h>
 #include <linux/phy.h>
@@ -60,9 +62,13 @@ extern struct mutex smi_lock;
  */
 DEFINE_MUTEX(poll_lock);
 
-static const struct firmware rtl838x_8380_fw;
-static const struct firmware rtl838x_8214fc_fw;
-static const struct firmware rtl838x_8218b_fw;
+/* Firmware files are loaded and verified once and then kept for all PHY
+ * packages using them. The lock serializes packages configured in parallel.
+ */
+static DEFINE_MUTEX(rtl838x_fw_lock);
+static const struct firmware *rtl838x_8380_fw;
+static const struct firmware *rtl838x_8214fc_fw;
+static const struct firmware *rtl838x_8218b_fw;
 
 static u64 disable_polling(int port)
 {
@@ -623,7 +629,7 @@ static int rtl8226_set_eee(struct phy_device *phydev, struct ethtool_eee *e)
 }
 
 static struct fw_header *rtl838x_request_fw(struct phy_device *phydev,
-					    const struct firmware *fw,
+					    const struct firmware **fw,
 					    const char *name)
 {
 	struct device *dev = &phydev->mdio.dev;
@@ -631,36 +637,51 @@ static struct fw_header *rtl838x_request_fw(struct phy_device *phydev,
 	struct fw_header *h;
 	uint32_t checksum, my_checksum;
 
-	err = request_firmware(&fw, name, dev);
+	mutex_lock(&rtl838x_fw_lock);
+
+	if (*fw) {
+		h = (struct fw_header *) (*fw)->data;
+		mutex_unlock(&rtl838x_fw_lock);
+		return h;
+	}
+
+	err = request_firmware(fw, name, dev);
 	if (err < 0)
 		goto out;
 
-	if (fw->size < sizeof(struct fw_header)) {
+	if ((*fw)->size < sizeof(struct fw_header)) {
 		pr_err("Firmware size too small.\n");
 		err = -EINVAL;
-		goto out;
+		goto out_release;
 	}
 
-	h = (struct fw_header *) fw->data;
-	pr_info("Firmware loaded. Size %d, magic: %08x\n", fw->size, h->magic);
+	h = (struct fw_header *) (*fw)->data;
+	pr_info("Firmware loaded. Size %d, magic: %08x\n", (*fw)->size, h->magic);
 
 	if (h->magic != 0x83808380) {
 		pr_err("Wrong firmware file: MAGIC mismatch.\n");
-		goto out;
+		err = -EINVAL;
+		goto out_release;
 	}
 
 	checksum = h->checksum;
 	h->checksum = 0;
-	my_checksum = ~crc32(0xFFFFFFFFU, fw->data, fw->size);
+	my_checksum = ~crc32(0xFFFFFFFFU, (*fw)->data, (*fw)->size);
 	if (checksum != my_checksum) {
 		pr_err("Firmware checksum mismatch.\n");
 		err = -EINVAL;
-		goto out;
+		goto out_release;
 	}
 	h->checksum = checksum;
 
+	mutex_unlock(&rtl838x_fw_lock);
+
 	return h;
+out_release:
+	release_firmware(*fw);
+	*fw = NULL;
 out:
+	mutex_unlock(&rtl838x_fw_lock);
 	dev_err(dev, "Unable to load firmware %s (%d)\n", name, err);
 	return NULL;
 }
@@ -865,7 +886,7 @@ static int rtl8380_configure_ext_rtl8218b(struct phy_device *phydev)
 		phy_package_port_write_paged(phydev, i, RTL83XX_PAGE_RAW, RTL8XXX_PAGE_SELECT, RTL8XXX_PAGE_MAIN);
 		phy_package_port_write_paged(phydev, i, RTL83XX_PAGE_RAW, 0x00, 0x1140);
 	}
-	mdelay(100);
+	msleep(100);
 
 	/* Request patch */
 	for (int i = 0; i < 8; i++) {
@@ -873,7 +894,7 @@ static int rtl8380_configure_ext_rtl8218b(struct phy_device *phydev)
 		phy_package_port_write_paged(phydev, i, RTL83XX_PAGE_RAW, 0x10, 0x0010);
 	}
 
-	mdelay(300);
+	msleep(300);
 
 	/* Verify patch readiness */
 	for (int i = 0; i < 8; i++) {
@@ -1377,7 +1398,7 @@ static int rtl8380_configure_rtl8214fc(struct phy_device *phydev)
 		phy_package_port_write_paged(phydev, i, RTL83XX_PAGE_RAW, RTL8XXX_PAGE_SELECT, RTL8XXX_PAGE_MAIN);
 		phy_package_port_write_paged(phydev, i, RTL83XX_PAGE_RAW, 0x00, 0x1140);
 	}
-	mdelay(100);
+	msleep(100);
 
 	/* Disable Autosensing */
 	for (int i = 0; i < 4; i++) {
@@ -1399,7 +1420,7 @@ static int rtl8380_configure_rtl8214fc(struct phy_device *phydev)
 		phy_package_port_write_paged(phydev, i, RTL83XX_PAGE_RAW, RTL8XXX_PAGE_SELECT, RTL821X_PAGE_PATCH);
 		phy_package_port_write_paged(phydev, i, RTL83XX_PAGE_RAW, 0x10, 0x0010);
 	}
-	mdelay(300);
+	msleep(300);
 
 	/* Verify patch readiness */
 	for (int i = 0; i < 4; i++) {
@@ -1459,7 +1480,7 @@ static int rtl8380_configure_serdes(struct phy_device *phydev)
 
 	phydev_info(phydev, "Detected internal RTL8380 SERDES\n");
 
-	h = rtl838x_request_fw(phydev, &rtl838x_8218b_fw, FIRMWARE_838X_8380_1);
+	h = rtl838x_request_fw(phydev, &rtl838x_8380_fw, FIRMWARE_838X_8380_1);
 	if (!h)
 		return -1;
 
@@ -3668,10 +3689,56 @@ int rtl931x_link_sts_get(u32 sds)
 	return sts1;
 }
 
+static void rtl83xx_package_configure_async(void *data, async_cookie_t cookie)
+{
+	struct phy_device *phydev = data;
+	struct rtl83xx_shared_private *shared = phydev->shared->priv;
+
+	shared->configure_err = shared->configure(phydev);
+	if (shared->configure_err)
+		phydev_err(phydev, "Configuring %s failed: %d\n", shared->name,
+			   shared->configure_err);
+
+	complete_all(&shared->configured);
+}
+
+/* Patching a PHY package takes the better part of a second, most of it
+ * waiting for the PHYs to become ready. Packages are independent of each
+ * other, so configure them in parallel and only wait for a package once
+ * one of its ports is actually used.
+ */
+static void rtl83xx_package_configure(struct phy_device *phydev,
+				      int (*configure)(struct phy_device *phydev))
+{
+	struct rtl83xx_shared_private *shared = phydev->shared->priv;
+
+	shared->configure = configure;
+	init_completion(&shared->configured);
+	async_schedule(rtl83xx_package_configure_async, phydev);
+}
+
+static int rtl83xx_package_wait(struct phy_device *phydev)
+{
+	struct rtl83xx_shared_private *shared = phydev->shared->priv;
+
+	if (!shared->configure)
+		return 0;
+
+	wait_for_completion(&shared->configured);
+
+	return shared->configure_err;
+}
+
+static int rtl83xx_package_config_init(struct phy_device *phydev)
+{
+	return rtl83xx_package_wait(phydev);
+}
+
 static int rtl8214fc_sfp_insert(void *upstream, const struct sfp_eeprom_id *id)
 {
 	struct phy_device *phydev = upstream;
 
+	rtl83xx_package_wait(phydev);
 	rtl8214fc_media_set(phydev, true);
 
 	return 0;
@@ -3681,6 +3748,7 @@ static void rtl8214fc_sfp_remove(void *upstream)
 {
 	struct phy_device *phydev = upstream;
 
+	rtl83xx_package_wait(phydev);
 	rtl8214fc_media_set(phydev, false);
 }
 
@@ -3695,7 +3763,6 @@ static int rtl8214fc_phy_probe(struct phy_device *phydev)
 {
 	struct device *dev = &phydev->mdio.dev;
 	int addr = phydev->mdio.addr;
-	int ret = 0;
 
 	/* 839x has internal SerDes */
 	if (soc_info.id == 0x8393)
@@ -3709,9 +3776,7 @@ static int rtl8214fc_phy_probe(struct phy_device *phydev)
 		struct rtl83xx_shared_private *shared = phydev->shared->priv;
 		shared->name = "RTL8214FC";
 		/* Configuration must be done while patching still possible */
-		ret = rtl8380_configure_rtl8214fc(phydev);
-		if (ret)
-			return ret;
+		rtl83xx_package_configure(phydev, rtl8380_configure_rtl8214fc);
 	}
 
 	return phy_sfp_probe(phydev, &rtl8214fc_sfp_ops);
@@ -3750,7 +3815,7 @@ static int rtl8218b_ext_phy_probe(struct phy_device *phydev)
 		shared->name = "RTL8218B (external)";
 		if (soc_info.family == RTL8380_FAMILY_ID) {
 			/* Configuration must be done while patching still possible */
-			return rtl8380_configure_ext_rtl8218b(phydev);
+			rtl83xx_package_configure(phydev, rtl8380_configure_ext_rtl8218b);
 		}
 	}
 
@@ -3776,7 +3841,7 @@ static int rtl8218b_int_phy_probe(struct phy_device *phydev)
 		struct rtl83xx_shared_private *shared = phydev->shared->priv;
 		shared->name = "RTL8218B (internal)";
 		/* Configuration must be done while patching still possible */
-		return rtl8380_configure_int_rtl8218b(phydev);
+		rtl83xx_package_configure(phydev, rtl8380_configure_int_rtl8218b);
 	}
 
 	return 0;
@@ -3878,6 +3943,7 @@ static struct phy_driver rtl83xx_phy_driver[] = {
 		.flags		= PHY_HAS_REALTEK_PAGES,
 		.match_phy_device = rtl8214fc_match_phy_device,
 		.probe		= rtl8214fc_phy_probe,
+		.config_init	= rtl83xx_package_config_init,
 		.suspend	= rtl8214fc_suspend,
 		.resume		= rtl8214fc_resume,
 		.set_loopback	= genphy_loopback,
@@ -3893,6 +3959,7 @@ static struct phy_driver rtl83xx_phy_driver[] = {
 		.flags		= PHY_HAS_REALTEK_PAGES,
 		.match_phy_device = rtl8218b_ext_match_phy_device,
 		.probe		= rtl8218b_ext_phy_probe,
+		.config_init	= rtl83xx_package_config_init,
 		.suspend	= genphy_suspend,
 		.resume		= genphy_resume,
 		.set_loopback	= genphy_loopback,
@@ -3947,6 +4014,7 @@ static struct phy_driver rtl83xx_phy_driver[] = {
 		.features	= PHY_GBIT_FEATURES,
 		.flags		= PHY_HAS_REALTEK_PAGES,
 		.probe		= rtl8218b_int_phy_probe,
+		.config_init	= rtl83xx_package_config_init,
 		.suspend	= genphy_suspend,
 		.resume		= genphy_resume,
 		.set_loopback	= genphy_loopback,
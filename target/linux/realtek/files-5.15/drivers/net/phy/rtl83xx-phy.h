@@ -2,6 +2,9 @@
 
 struct rtl83xx_shared_private {
 	char *name;
+	int (*configure)(struct phy_device *phydev);
+	struct completion configured;
+	int configure_err;
 };
 
 struct __attribute__ ((__packed__)) part {